@@ -3,12 +3,7 @@ const std = @import("std");
 pub fn build(b: *std.Build) void {
     const target = b.standardTargetOptions(.{});
 
-    // Create the executable
-    const bin = b.addExecutable(.{
-        .name = "sac",
-        .target = target,
-        .optimize = .ReleaseFast,
-    });
+    const shared = b.option(bool, "shared", "Build libsac as a shared library") orelse false;
 
     // List include directories
     const include_dirs = [_][]const u8{
@@ -20,23 +15,64 @@ pub fn build(b: *std.Build) void {
         "src/pred/",
     };
 
-    const cpp_srcs = &[_][]const u8{
-        "src/main.cpp",
-        "src/cmdline.cpp",
+    // Library sources (codec without the command line)
+    const lib_srcs = &[_][]const u8{
         "src/common/md5.cpp",
+        "src/common/simd.cpp",
         "src/common/utils.cpp",
+        "src/common/xxhash.cpp",
         "src/file/file.cpp",
         "src/file/sac.cpp",
         "src/file/wav.cpp",
+        "src/libsac/checkpoint.cpp",
         "src/libsac/libsac.cpp",
         "src/libsac/map.cpp",
         "src/libsac/pred.cpp",
         "src/libsac/profile.cpp",
+        "src/libsac/sacapi.cpp",
         "src/libsac/vle.cpp",
         "src/model/range.cpp",
         "src/pred/rls.cpp",
     };
 
+    const cpp_srcs = &[_][]const u8{
+        "src/main.cpp",
+        "src/cmdline.cpp",
+    };
+
+    // Create the library
+    const lib = if (shared) b.addSharedLibrary(.{
+        .name = "sac",
+        .target = target,
+        .optimize = .ReleaseFast,
+    }) else b.addStaticLibrary(.{
+        .name = "sac",
+        .target = target,
+        .optimize = .ReleaseFast,
+    });
+
+    for (include_dirs) |dir| {
+        lib.addIncludePath(b.path(dir));
+    }
+
+    lib.addCSourceFiles(.{
+        .files = lib_srcs,
+        .flags = &.{
+            "-std=c++20",
+            "-O3",
+        },
+    });
+    lib.linkLibCpp();
+    lib.installHeader(b.path("src/libsac/sacapi.h"), "sacapi.h");
+    b.installArtifact(lib);
+
+    // Create the executable
+    const bin = b.addExecutable(.{
+        .name = "sac",
+        .target = target,
+        .optimize = .ReleaseFast,
+    });
+
     for (include_dirs) |dir| {
         bin.addIncludePath(b.path(dir));
     }
@@ -45,13 +81,41 @@ pub fn build(b: *std.Build) void {
     bin.addCSourceFiles(.{
         .files = cpp_srcs,
         .flags = &.{
-            "-std=c++11",
+            "-std=c++20",
             "-static",
             "-O3",
         },
     });
 
-    // Link libc
+    // Link libsac and libc
+    bin.linkLibrary(lib);
     bin.linkLibCpp();
     b.installArtifact(bin);
+
+    // Tests, run with zig build test
+    const test_step = b.step("test", "Run the tests");
+    const tests = [_][]const u8{
+        "hash",
+        "pcm32",
+    };
+    for (tests) |name| {
+        const t = b.addExecutable(.{
+            .name = b.fmt("test_{s}", .{name}),
+            .target = target,
+            .optimize = .ReleaseFast,
+        });
+        for (include_dirs) |dir| {
+            t.addIncludePath(b.path(dir));
+        }
+        t.addCSourceFile(.{
+            .file = b.path(b.fmt("tests/test_{s}.cpp", .{name})),
+            .flags = &.{
+                "-std=c++20",
+                "-O2",
+            },
+        });
+        t.linkLibrary(lib);
+        t.linkLibCpp();
+        test_step.dependOn(&b.addRunArtifact(t).step);
+    }
 }
@@ -2,24 +2,70 @@
 #include "common/utils.h"
 #include "common/timer.h"
 #include "file/sac.h"
+#include "libsac/checkpoint.h"
 #include <cstring>
 #include <sstream>
 #include <algorithm>
+#include <filesystem>
+#ifdef _WIN32
+  #include <io.h>
+  #include <fcntl.h>
+#endif
 
-CmdLine::CmdLine()
-:mode(ENCODE)
+CmdLine::CmdLine(std::streambuf *stdout_buf)
+:mode(ENCODE),range_start(0),range_len(-1),batch(false),checkpoint(false),resume(false),num_threads(0),stdout_buf(stdout_buf)
 {
 }
 
+// true if the second non-option argument is '-'
+bool CmdLine::OutputIsStdout(int argc,char *argv[])
+{
+  int nfiles=0;
+  for (int k=1;k<argc;k++) {
+    std::string param=argv[k];
+    if (param.length()>1 && param[0]=='-' && param[1]=='-') continue;
+    if (++nfiles==2) return param=="-";
+  }
+  return false;
+}
+
+int CmdLine::OpenInput(AudioFile &file)
+{
+  if (sinputfile=="-") {
+    #ifdef _WIN32
+      _setmode(_fileno(stdin),_O_BINARY);
+    #endif
+    return file.OpenStream(std::cin.rdbuf());
+  } else return file.OpenRead(sinputfile);
+}
+
+int CmdLine::OpenOutput(AudioFile &file)
+{
+  if (soutputfile=="-") {
+    #ifdef _WIN32
+      _setmode(_fileno(stdout),_O_BINARY);
+    #endif
+    return file.OpenStream(stdout_buf);
+  } else return file.OpenWrite(soutputfile);
+}
+
+// format 2 streams don't tell if the encoder used fma
+static void HintFormat(const Sac &mySac,const FrameCoder::coder_ctx &opt)
+{
+  if (mySac.mcfg.format<Sac::FORMAT)
+    std::cerr << "  warning: format " << int(mySac.mcfg.format) << " stream, retry " << (opt.sac2_fma?"without":"with") << " --sac2-fma\n";
+}
+
 void CmdLine::PrintWav(const AudioFile &myWav)
 {
-  std::cout << "  WAVE  Codec: PCM (" << myWav.getKBPS() << " kbps)\n";
+  std::cout << "  WAVE  Codec: " << (myWav.isFloat()?"IEEE float":"PCM") << " (" << myWav.getKBPS() << " kbps)\n";
   std::cout << "  " << myWav.getSampleRate() << "Hz " << myWav.getBitsPerSample() << " Bit  ";
   if (myWav.getNumChannels()==1) std::cout << "Mono";
   else if (myWav.getNumChannels()==2) std::cout << "Stereo";
   else std::cout << myWav.getNumChannels() << " Channels";
   std::cout << "\n";
-  std::cout << "  " << myWav.getNumSamples() << " Samples [" << miscUtils::getTimeStrFromSamples(myWav.getNumSamples(),myWav.getSampleRate()) << "]\n";
+  if (myWav.getNumSamples()<0) std::cout << "  unknown length (streamed)\n";
+  else std::cout << "  " << myWav.getNumSamples() << " Samples [" << miscUtils::getTimeStrFromSamples(myWav.getNumSamples(),myWav.getSampleRate()) << "]\n";
 }
 
 void CmdLine::PrintMode()
@@ -28,9 +74,12 @@ void CmdLine::PrintMode()
   std::cout << "  Profile: ";
   std::cout << "mt" << opt.mt_mode;
   std::cout << " " << opt.max_framelen << "s";
+  if (opt.frame_threads>1) std::cout << " ft" << opt.frame_threads;
   if (opt.adapt_block) std::cout << " ab";
   if (opt.zero_mean) std::cout << " zero-mean";
   if (opt.sparse_pcm) std::cout << " sparse-pcm";
+  if (opt.ols_solver==OLS::UPDATE) std::cout << " ols-update";
+  if (opt.frame_crc) std::cout << " crc";
   std::cout << '\n';
   if (opt.optimize) {
       std::ostringstream oss;
@@ -106,45 +155,35 @@ int CmdLine::Parse(int argc,char *argv[])
         return 1;
       }
        else if (key=="--DECODE") mode=DECODE;
+       else if (key=="--DECODE-RANGE") {
+         std::string sstart,slen;
+         Split(val,sstart,slen,':');
+         if (sstart.length() && slen.length()) {
+           mode=DECODE;
+           range_start=std::max(0LL,std::stoll(sstart));
+           range_len=std::max(0LL,std::stoll(slen));
+         } else std::cerr << "  warning: invalid range '" << val << "'\n";
+       }
+       else if (key=="--VERIFY") mode=VERIFY;
        else if (key=="--LIST") mode=LIST;
        else if (key=="--LISTFULL") mode=LISTFULL;
+       else if (key=="--BATCH") batch=true;
+       else if (key=="--CHECKPOINT") checkpoint=true;
+       else if (key=="--RESUME") checkpoint=resume=true;
+       else if (key=="--THREADS") {
+         if (val.length()) num_threads=clamp(stoi(val),1,1024);
+       }
        else if (key=="--VERBOSE") {
           if (val.length()) opt.verbose_level=std::max(0,stoi(val));
           else opt.verbose_level=1;
        }
-       else if (key=="--NORMAL") {
-         opt.optimize=0;
-       } else if (key=="--HIGH") {
-         opt.optimize=1;
-         opt.ocfg.fraction=0.075;
-         opt.ocfg.maxnfunc=100;
-         opt.ocfg.sigma=0.2;
-         opt.ocfg.dds_cfg.c_fail_max=30;
-       } else if (key=="--VERYHIGH") {
-         opt.optimize=1;
-         opt.ocfg.fraction=0.2;
-         opt.ocfg.maxnfunc=250;
-         opt.ocfg.sigma=0.2;
-       } else if (key=="--EXTRAHIGH") {
-         opt.optimize=1;
-         opt.ocfg.fraction=0.25;
-         opt.ocfg.maxnfunc=500;
-         opt.ocfg.sigma=0.2;
-       } else if (key=="--BEST") {
-         opt.optimize=1;
-         opt.ocfg.fraction=0.50;
-         opt.ocfg.maxnfunc=1000;
-         opt.ocfg.optk=2;
-         opt.ocfg.sigma=0.20;
-         opt.ocfg.optimize_cost=FrameCoder::SearchCost::Bitplane;
-       } else if (key=="--INSANE") {
-         opt.optimize=1;
-         opt.ocfg.fraction=0.75;
-         opt.ocfg.maxnfunc=1500;
-         opt.ocfg.optk=2;
-         opt.ocfg.sigma=0.25;
-         opt.ocfg.optimize_cost=FrameCoder::SearchCost::Bitplane;
-       } else if (key=="--OPTIMIZE") {
+       else if (key=="--NORMAL") opt.SetPreset(0);
+       else if (key=="--HIGH") opt.SetPreset(1);
+       else if (key=="--VERYHIGH") opt.SetPreset(2);
+       else if (key=="--EXTRAHIGH") opt.SetPreset(3);
+       else if (key=="--BEST") opt.SetPreset(4);
+       else if (key=="--INSANE") opt.SetPreset(5);
+       else if (key=="--OPTIMIZE") {
          if (val=="NO" || val=="0") opt.optimize=0;
          else {
           std::vector<std::string>vs;
@@ -175,9 +214,29 @@ int CmdLine::Parse(int argc,char *argv[])
        else if (key=="--MT-MODE") {
          if (val.length()) opt.mt_mode=std::max(0,stoi(val));
        }
+       else if (key=="--FRAME-THREADS") {
+         if (val.length()) opt.frame_threads=clamp(stoi(val),1,256);
+       }
        else if (key=="--SPARSE-PCM") {
           if (val=="NO" || val=="0") opt.sparse_pcm=0;
           else opt.sparse_pcm=1;
+       } else if (key=="--SEEK-TABLE") {
+         if (val=="NO" || val=="0") opt.seek_table=0;
+         else opt.seek_table=1;
+       } else if (key=="--FRAME-CRC") {
+         if (val=="NO" || val=="0") opt.frame_crc=0;
+         else opt.frame_crc=1;
+       } else if (key=="--SAC2-FMA") {
+         if (val=="NO" || val=="0") opt.sac2_fma=0;
+         else opt.sac2_fma=1;
+       } else if (key=="--HASH") {
+         if (val=="MD5") opt.hash=AudioHash::HASH_MD5;
+         else if (val=="XXH64") opt.hash=AudioHash::HASH_XXH64;
+         else std::cerr << "  warning: invalid val='" << val << "'\n";
+       } else if (key=="--OLS-SOLVER") {
+         if (val=="CHOL" || val=="0") opt.ols_solver=OLS::CHOLESKY;
+         else if (val=="UPDATE" || val=="1") opt.ols_solver=OLS::UPDATE;
+         else std::cerr << "  warning: invalid val='" << val << "'\n";
        } else if (key=="--STEREO-MS") {
          opt.stereo_ms=1;
        } else if (key=="--OPT-RESET") {
@@ -207,49 +266,62 @@ int CmdLine::Parse(int argc,char *argv[])
     }
     k++;
   }
-  // configure opt method
-  if (opt.ocfg.optimize_search==FrameCoder::SearchMethod::DDS)
-  {
-    opt.ocfg.dds_cfg.nfunc_max=opt.ocfg.maxnfunc;
-    opt.ocfg.dds_cfg.num_threads=opt.ocfg.num_threads;
-    opt.ocfg.dds_cfg.sigma_init=opt.ocfg.sigma;
-  } else if (opt.ocfg.optimize_search==FrameCoder::SearchMethod::DE)
-  {
-    opt.ocfg.de_cfg.nfunc_max=opt.ocfg.maxnfunc;
-    opt.ocfg.de_cfg.num_threads=opt.ocfg.num_threads;
-    opt.ocfg.de_cfg.sigma_init=opt.ocfg.sigma;
-  }
+  opt.ConfigureOpt();
 
   return 0;
 }
 
 int CmdLine::Process()
 {
+  ThreadPool::Shared(num_threads); // first use fixes the size
+  if (batch) return ProcessBatch();
+  // nothing is written, so a single file is spread over the pool by frames
+  if (mode==VERIFY && opt.frame_threads==1) opt.frame_threads=ThreadPool::Shared().NumThreads();
+
   Timer myTimer;
   myTimer.start();
+  int ret=0;
 
   if (mode==ENCODE) {
     Wav myWav(opt.verbose_level>0);
     std::cout << "Open: '" << sinputfile << "': ";
-    if (myWav.OpenRead(sinputfile)==0) {
-      std::cout << "ok (" << myWav.getFileSize() << " Bytes)\n";
+    if (OpenInput(myWav)==0) {
+      if (myWav.isStreamed()) std::cout << "ok (stream)\n";
+      else std::cout << "ok (" << myWav.getFileSize() << " Bytes)\n";
       if (myWav.ReadHeader()==0) {
          PrintWav(myWav);
 
-         bool fsupp=(myWav.getBitsPerSample()<=24) && ( (myWav.getNumChannels()==2) || (myWav.getNumChannels()==1));
+         const int bits=myWav.getBitsPerSample();
+         bool fsupp=(bits<=24 || bits==32) && (myWav.getNumChannels()>=1) && (myWav.getNumChannels()<=FrameCoder::max_channels);
          if (!fsupp)
          {
             std::cerr << "unsupported input format" << std::endl;
-            std::cerr << "must be 1-16 bit, mono/stereo, pcm" << std::endl;
+            std::cerr << "must be 1-24 or 32 bit, 1-" << FrameCoder::max_channels << " channels, pcm" << std::endl;
             myWav.Close();
             return 1;
          }
          Sac mySac(myWav);
-         std::cout << "Create: '" << soutputfile << "': ";
-         if (mySac.OpenWrite(soutputfile)==0) {
-           std::cout << "ok\n";
+         // a usable checkpoint continues the partial output in place
+         const bool ckpt_files=checkpoint && sinputfile!="-" && soutputfile!="-";
+         const std::string ckpt_file=ckpt_files?Checkpoint::SidecarName(soutputfile):std::string();
+         Checkpoint ckpt;
+         bool resumed=false;
+         if (ckpt_files && resume) {
+           std::error_code ec;
+           const auto sacsize=std::filesystem::file_size(soutputfile,ec);
+           if (ckpt.Load(ckpt_file)==0 && ckpt.Matches(myWav) && !ec && sacsize>=ckpt.sacpos) {
+             std::filesystem::resize_file(soutputfile,ckpt.sacpos,ec);
+             resumed=!ec;
+           }
+           if (!resumed) std::cerr << "  warning: no usable checkpoint, starting over\n";
+         }
+         std::cout << (resumed?"Resume: '":"Create: '") << soutputfile << "': ";
+         if ((resumed?mySac.OpenUpdate(soutputfile):OpenOutput(mySac))==0) {
+           if (resumed) std::cout << "ok (at sample " << ckpt.samplescoded << ")\n";
+           else std::cout << "ok\n";
            PrintMode();
            Codec myCodec(opt);
+           if (ckpt_files) myCodec.SetCheckpoint(ckpt_file,resumed?&ckpt:nullptr);
 
            Timer time;
            time.start();
@@ -257,9 +329,9 @@ int CmdLine::Process()
            time.stop();
 
            uint64_t infilesize=myWav.getFileSize();
-           uint64_t outfilesize=mySac.readFileSize();
+           uint64_t outfilesize=mySac.isStreamed()?0:static_cast<uint64_t>(mySac.readFileSize());
            double r=0.,bps=0.;
-           if (outfilesize) {
+           if (outfilesize && infilesize) {
              r=outfilesize*100.0/infilesize;
              bps=(outfilesize*8.)/static_cast<double>(myWav.getNumSamples()*myWav.getNumChannels());
            }
@@ -271,24 +343,29 @@ int CmdLine::Process()
            oss1 << std::fixed << std::setprecision(1) << r;
            oss2 << std::fixed << std::setprecision(3) << bps;
            oss3 << std::fixed << std::setprecision(3) << xrate;
-           std::cout << "\n  " << infilesize << "->" << outfilesize<< "=";
-           std::cout << oss1.str() << "% (" << oss2.str() <<" bps)";
+           if (infilesize && outfilesize) {
+             std::cout << "\n  " << infilesize << "->" << outfilesize<< "=";
+             std::cout << oss1.str() << "% (" << oss2.str() <<" bps)";
+           } else std::cout << "\n  " << myWav.getNumSamples() << " Samples streamed";
            std::cout << "  " << oss3.str() << 'x' << '\n';
            mySac.Close();
          } else std::cout << "could not create\n";
       } else std::cout << "warning: input is not a valid .wav file\n";
       myWav.Close();
     } else std::cout << "could not open\n";
-  } else if (mode==LIST || mode==LISTFULL || mode==DECODE) {
+  } else if (mode==LIST || mode==LISTFULL || mode==DECODE || mode==VERIFY) {
     Sac mySac;
     std::cout << "Open: '" << sinputfile << "': ";
-    if (mySac.OpenRead(sinputfile)==0) {
+    if (OpenInput(mySac)==0) {
       std::streampos FileSizeSAC = mySac.getFileSize();
-      std::cout << "ok (" << FileSizeSAC << " Bytes)\n";
+      if (mySac.isStreamed()) std::cout << "ok (stream)\n";
+      else std::cout << "ok (" << FileSizeSAC << " Bytes)\n";
       if (mySac.ReadSACHeader()==0) {
         uint8_t md5digest[16];
         mySac.ReadMD5(md5digest);
-        double bps=(static_cast<double>(FileSizeSAC)*8.0)/static_cast<double>(mySac.getNumSamples()*mySac.getNumChannels());
+        if (mySac.mcfg.flags&Sac::STREAMED) std::memcpy(md5digest,mySac.trailer_digest,16);
+        double bps=0.;
+        if (mySac.getNumSamples()>0) bps=(static_cast<double>(FileSizeSAC)*8.0)/static_cast<double>(mySac.getNumSamples()*mySac.getNumChannels());
         int kbps=round((mySac.getSampleRate()*mySac.getNumChannels()*bps)/1000);
         mySac.setKBPS(kbps);
         PrintWav(mySac);
@@ -297,19 +374,59 @@ int CmdLine::Process()
         std::cout << " " << static_cast<int>(mySac.mcfg.max_framelen) << "s";
         std::cout << std::endl;
         std::cout << "  Ratio:   " << std::fixed << std::setprecision(3) << bps << " bps\n\n";
-        std::cout << "  Audio MD5: ";
-        for (auto x : md5digest) std::cout << std::hex << (int)x;
+        const AudioHash listhash(mySac.GetHashType());
+        std::cout << "  Audio " << listhash.Name() << ": ";
+        if ((mySac.mcfg.flags&Sac::STREAMED) && mySac.isStreamed()) std::cout << "(trailer)";
+        else for (int i=0;i<listhash.Size();i++) std::cout << std::hex << (int)md5digest[i];
         std::cout << std::dec << '\n';
 
 
         if (mode==LISTFULL) {
           Codec myCodec;
           myCodec.ScanFrames(mySac);
+        } else if (mode==VERIFY) {
+          Wav myWav(mySac);
+          Timer time;
+          time.start();
+
+          Codec myCodec(opt);
+          myCodec.DecodeFile(mySac,myWav,true);
+          myWav.FinishHash();
+          time.stop();
+
+          double xrate=0.0;
+          if (time.elapsedS() > 0.0)
+          xrate=(myWav.getNumSamples()/double(myWav.getSampleRate()))/time.elapsedS();
+          std::cout << "\n  Speed " << std::fixed << std::setprecision(3) << xrate << "x\n";
+
+          std::cout << "  Audio " << myWav.hash.Name() << ": ";
+          if (mySac.mcfg.flags&Sac::STREAMED) std::memcpy(md5digest,mySac.trailer_digest,16);
+          if (std::memcmp(myWav.hash.digest,md5digest,16)==0) std::cout << "ok\n";
+          else {
+            std::cout << "Error (";
+            for (int i=0;i<myWav.hash.Size();i++) std::cout << std::hex << (int)myWav.hash.digest[i];
+            std::cout << std::dec << ")\n";
+            HintFormat(mySac,opt);
+            ret=1;
+          }
         } else if (mode==DECODE) {
 
           Wav myWav(mySac);
           std::cout << "Create: '" << soutputfile << "': ";
-          if (myWav.OpenWrite(soutputfile)==0) {
+          if (range_len>=0) {
+            if (OpenOutput(myWav)==0) {
+              std::cout << "ok\n";
+              const int64_t nsamples=std::max(int64_t(0),std::min(range_len,mySac.getNumSamples()-range_start));
+              std::cout << "  Range:   " << range_start << ":" << nsamples;
+              if (mySac.seektable.size()) std::cout << " (seek table)";
+              std::cout << '\n';
+              myWav.InitPCMHeader(static_cast<int>(nsamples));
+
+              Codec myCodec(opt);
+              if (myCodec.DecodeRange(mySac,myWav,range_start,nsamples)!=0) std::cerr << "  error: range decode failed\n";
+              myWav.Close();
+            } else std::cout << "could not create\n";
+          } else if (OpenOutput(myWav)==0) {
             std::cout << "ok\n";
 
             Timer time;
@@ -317,7 +434,7 @@ int CmdLine::Process()
 
             Codec myCodec(opt);
             myCodec.DecodeFile(mySac,myWav);
-            MD5::Finalize(&myWav.md5ctx);
+            myWav.FinishHash();
             time.stop();
 
             double xrate=0.0;
@@ -325,22 +442,182 @@ int CmdLine::Process()
             xrate=(myWav.getNumSamples()/double(myWav.getSampleRate()))/time.elapsedS();
             std::cout << "\n  Speed " << std::fixed << std::setprecision(3) << xrate << "x\n";
 
-            std::cout << "  Audio MD5: ";
-            bool md5diff=std::memcmp(myWav.md5ctx.digest, md5digest, 16);
+            std::cout << "  Audio " << myWav.hash.Name() << ": ";
+            if (mySac.mcfg.flags&Sac::STREAMED) std::memcpy(md5digest,mySac.trailer_digest,16);
+            bool md5diff=std::memcmp(myWav.hash.digest, md5digest, 16);
             if (!md5diff) std::cout << "ok\n";
             else {
               std::cout << "Error (";
-              for (auto x : myWav.md5ctx.digest) std::cout << std::hex << (int)x;
+              for (int i=0;i<myWav.hash.Size();i++) std::cout << std::hex << (int)myWav.hash.digest[i];
               std::cout << std::dec << ")\n";
+              HintFormat(mySac,opt);
             }
             myWav.Close();
           } else std::cout << "could not create\n";
         }
-      } else std::cout << "warning: input is not a valid .sac file\n";
-    }
-  } else std::cout << "could not open\n";
+      } else {std::cout << "warning: input is not a valid .sac file\n";ret=1;}
+    } else {std::cout << "could not open\n";ret=1;}
+  }
 
   myTimer.stop();
   std::cout << "\n  Time:    [" << miscUtils::getTimeStrFromSeconds(round(myTimer.elapsedS())) << "]" << std::endl;
-  return 0;
+  return ret;
+}
+
+// (input,output) pairs of a batch: all matching files below a directory
+// or one path per line of a list file. Outputs go to soutputfile if given
+std::vector<std::pair<std::string,std::string>> CmdLine::CollectBatch()
+{
+  namespace fs=std::filesystem;
+  const std::string ext_in=(mode==ENCODE)?".WAV":".SAC";
+  const std::string ext_out=(mode==ENCODE)?".sac":".wav";
+
+  std::vector<std::pair<fs::path,fs::path>> files; // path, relative output path
+  std::error_code ec;
+  if (fs::is_directory(sinputfile,ec)) {
+    for (const auto &entry:fs::recursive_directory_iterator(sinputfile,ec)) {
+      if (entry.is_regular_file() && StrUtils::str_up(entry.path().extension().string())==ext_in)
+        files.push_back({entry.path(),fs::relative(entry.path(),sinputfile,ec)});
+    }
+    std::sort(begin(files),end(files));
+  } else {
+    std::ifstream flist(sinputfile);
+    if (!flist.is_open()) {
+      std::cerr << "  error: could not open '" << sinputfile << "'\n";
+      return {};
+    }
+    std::string line;
+    while (std::getline(flist,line)) {
+      while (line.length() && (line.back()=='\r' || line.back()==' ')) line.pop_back();
+      if (line.length()) files.push_back({fs::path(line),fs::path(line).filename()});
+    }
+  }
+
+  std::vector<std::pair<std::string,std::string>> jobs;
+  for (const auto &file:files) {
+    fs::path out=soutputfile.length()?fs::path(soutputfile)/file.second:file.first;
+    out.replace_extension(ext_out);
+    if (mode!=VERIFY && out.has_parent_path()) fs::create_directories(out.parent_path(),ec);
+    jobs.push_back({file.first.string(),out.string()});
+  }
+  return jobs;
+}
+
+CmdLine::tbatch_result CmdLine::EncodeBatchFile(const std::string &sin,const std::string &sout,const FrameCoder::coder_ctx &bopt)
+{
+  tbatch_result res;
+  Wav myWav;
+  if (myWav.OpenRead(sin)!=0) {res.msg="could not open";return res;}
+  if (myWav.ReadHeader()!=0) {res.msg="not a valid .wav file";return res;}
+  if ((myWav.getBitsPerSample()>24 && myWav.getBitsPerSample()!=32) || myWav.getNumChannels()<1 || myWav.getNumChannels()>FrameCoder::max_channels) {res.msg="unsupported input format";return res;}
+
+  Sac mySac(myWav);
+  if (mySac.OpenWrite(sout)!=0) {res.msg="could not create '"+sout+"'";return res;}
+  FrameCoder::coder_ctx fopt=bopt;
+  Codec myCodec(fopt);
+  myCodec.EncodeFile(myWav,mySac);
+
+  res.ok=true;
+  res.numsamples=myWav.getNumSamples();
+  res.samplerate=myWav.getSampleRate();
+  res.inbytes=myWav.getFileSize();
+  res.outbytes=mySac.readFileSize();
+  mySac.Close();
+  myWav.Close();
+  return res;
+}
+
+CmdLine::tbatch_result CmdLine::DecodeBatchFile(const std::string &sin,const std::string &sout,const FrameCoder::coder_ctx &bopt)
+{
+  tbatch_result res;
+  Sac mySac;
+  if (mySac.OpenRead(sin)!=0) {res.msg="could not open";return res;}
+  if (mySac.ReadSACHeader()!=0) {res.msg="not a valid .sac file";return res;}
+  uint8_t md5digest[16];
+  mySac.ReadMD5(md5digest);
+
+  // verify mode hashes the decoded pcm in memory and writes nothing
+  const bool verify_only=(mode==VERIFY);
+  Wav myWav(mySac);
+  if (!verify_only && myWav.OpenWrite(sout)!=0) {res.msg="could not create '"+sout+"'";return res;}
+  FrameCoder::coder_ctx fopt=bopt;
+  Codec myCodec(fopt);
+  myCodec.DecodeFile(mySac,myWav,verify_only);
+  myWav.FinishHash();
+  if (mySac.mcfg.flags&Sac::STREAMED) std::memcpy(md5digest,mySac.trailer_digest,16);
+
+  res.ok=std::memcmp(myWav.hash.digest,md5digest,16)==0;
+  if (!res.ok) res.msg=std::string(myWav.hash.Name())+" mismatch";
+  res.numsamples=myWav.getNumSamples();
+  res.samplerate=myWav.getSampleRate();
+  res.inbytes=mySac.getFileSize();
+  if (!verify_only) res.outbytes=myWav.readFileSize();
+  myWav.Close();
+  mySac.Close();
+  return res;
+}
+
+// whole files, frames, channels and optimizer runs share one pool,
+// so the thread count is capped no matter how short the files are
+int CmdLine::ProcessBatch()
+{
+  if (mode!=ENCODE && mode!=DECODE && mode!=VERIFY) {
+    std::cerr << "  error: batch mode supports --encode, --decode and --verify only\n";
+    return 1;
+  }
+  const std::vector<std::pair<std::string,std::string>> jobs=CollectBatch();
+  if (jobs.empty()) {
+    std::cout << "  no input files\n";
+    return 1;
+  }
+  ThreadPool &pool=ThreadPool::Shared();
+
+  FrameCoder::coder_ctx bopt=opt;
+  bopt.quiet=1;
+
+  std::cout << "Batch: " << jobs.size() << " files, " << pool.NumThreads() << " threads\n";
+  if (mode==ENCODE) PrintMode();
+
+  Timer myTimer;
+  myTimer.start();
+
+  std::vector<std::future<tbatch_result>> results;
+  for (const auto &job:jobs) {
+    if (mode==ENCODE) results.push_back(pool.Submit([this,job,&bopt]{return EncodeBatchFile(job.first,job.second,bopt);}));
+    else results.push_back(pool.Submit([this,job,&bopt]{return DecodeBatchFile(job.first,job.second,bopt);}));
+  }
+
+  int nfailed=0;
+  double audio_seconds=0.;
+  uint64_t total_in=0,total_out=0;
+  for (std::size_t i=0;i<results.size();i++) {
+    tbatch_result res=results[i].get();
+    std::cout << "  [" << (i+1) << "/" << results.size() << "] " << jobs[i].first << ": ";
+    if (res.ok) {
+      if (mode==VERIFY) std::cout << "ok\n";
+      else std::cout << res.inbytes << "->" << res.outbytes << '\n';
+      if (res.samplerate>0) audio_seconds+=res.numsamples/static_cast<double>(res.samplerate);
+      total_in+=res.inbytes;
+      total_out+=res.outbytes;
+    } else {
+      std::cout << "error (" << res.msg << ")\n";
+      nfailed++;
+    }
+  }
+  myTimer.stop();
+
+  const double elapsed=myTimer.elapsedS();
+  std::cout << "\n  Files:   " << (results.size()-nfailed) << " ok, " << nfailed << " failed\n";
+  if (mode!=VERIFY) {
+    std::cout << "  Size:    " << total_in << "->" << total_out;
+    if (total_in) std::cout << "=" << miscUtils::ConvertFixed(total_out*100.0/total_in,1) << "%";
+    std::cout << '\n';
+  }
+  if (elapsed>0.) {
+    std::cout << "  Speed:   " << miscUtils::ConvertFixed(audio_seconds/elapsed,3) << "x, ";
+    std::cout << miscUtils::ConvertFixed(total_in/(elapsed*1024.*1024.),2) << " MiB/s, ";
+    std::cout << miscUtils::ConvertFixed(results.size()/elapsed,2) << " files/s\n";
+  }
+  std::cout << "  Time:    [" << miscUtils::getTimeStrFromSeconds(round(elapsed)) << "]" << std::endl;
+  return nfailed?1:0;
 }
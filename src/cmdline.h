@@ -6,15 +6,23 @@
 #include "libsac/libsac.h"
 
 const char SACHelp[] =
-"usage: sac [--options] input output\n\n"
+"usage: sac [--options] input output\n"
+"  use '-' for stdin/stdout, messages then go to stderr\n\n"
 "  --encode            encode input.wav to output.sac (def)\n"
 "    --normal|high|veryhigh|extrahigh compression (def=normal)\n"
 "    --best            you asked for it\n\n"
 "  --decode            decode input.sac to output.wav\n"
+"  --decode-range=s:n  decode n samples starting at sample s\n"
+"  --verify            decode input.sac and check the digest, no output\n"
 "  --list              list info about input.sac\n"
 "  --listfull          verbose info about input\n"
-"  --verbose           verbose output\n\n"
-"  supported types: 1-16 bit, mono/stereo pcm\n"
+"  --verbose           verbose output\n"
+"  --batch             en/decode/verify all files of input (dir or list file)\n"
+"                      into output dir (def: next to input)\n"
+"  --checkpoint        keep a resume point in output.sac.ckpt while encoding\n"
+"  --resume            continue an interrupted --checkpoint encode (same options)\n"
+"  --threads=n         size of the worker pool (def=all cores)\n\n"
+"  supported types: 1-24 bit, 32 bit int/float, 1-256 channel pcm\n"
 "  advanced options    (automatically set)\n"
 "   --optimize=#       frame-based optimization\n"
 "     no|s,n,c,k       s=[0,1.0],n=[0,10000]\n"
@@ -22,16 +30,31 @@ const char SACHelp[] =
 "   --opt-cfg=#        configure optimization method\n"
 "     de|dds,nt,s      nt=num threads,s=search radius (def=0.2)\n"
 "   --opt-reset        reset opt params at frame boundaries\n"
-"   --mt-mode=n        multi-threading level n=[0-2]\n"
+"   --mt-mode=n        multi-threading level n=[0-3], 3=pipelined stereo\n"
+"   --frame-threads=n  en/decode n frames in parallel (def=1)\n"
+"                      optimized output depends on n\n"
 "   --zero-mean        zero-mean input\n"
 "   --adapt-block      adaptive frame splitting\n"
 "   --framelen=n       def=20 seconds\n"
+"   --seek-table       append a frame seek table\n"
+"   --hash=#           md5|xxh64 pcm digest (def=md5)\n"
+"   --frame-crc        crc32c per frame, damaged frames are skipped\n"
+"   --ols-solver=#     chol|update, update is O(n^2) per sample\n"
+"   --sac2-fma         format 2 input was written by an fma build\n"
 "   --sparse-pcm       enable pcm modelling\n";
 
 class CmdLine {
-  enum CMODE {ENCODE,DECODE,LIST,LISTFULL};
+  enum CMODE {ENCODE,DECODE,LIST,LISTFULL,VERIFY};
+  struct tbatch_result {
+    bool ok=false;
+    int64_t numsamples=0;
+    int samplerate=0;
+    uint64_t inbytes=0,outbytes=0;
+    std::string msg;
+  };
   public:
-    CmdLine();
+    CmdLine(std::streambuf *stdout_buf=std::cout.rdbuf());
+    static bool OutputIsStdout(int argc,char *argv[]);
     int Parse(int argc,char *argv[]);
     int Process();
   private:
@@ -39,8 +62,18 @@ class CmdLine {
     void PrintMode();
     void PrintWav(const AudioFile &myWav);
     void Split(const std::string &str,std::string &key,std::string &val,const char splitval='=');
+    int OpenInput(AudioFile &file);
+    int OpenOutput(AudioFile &file);
+    int ProcessBatch();
+    std::vector<std::pair<std::string,std::string>> CollectBatch();
+    tbatch_result EncodeBatchFile(const std::string &sin,const std::string &sout,const FrameCoder::coder_ctx &bopt);
+    tbatch_result DecodeBatchFile(const std::string &sin,const std::string &sout,const FrameCoder::coder_ctx &bopt);
     std::string sinputfile,soutputfile;
     CMODE mode;
+    int64_t range_start,range_len;
+    bool batch,checkpoint,resume;
+    int num_threads;
+    std::streambuf *stdout_buf;
     FrameCoder::coder_ctx opt;
 };
 
@@ -19,8 +19,10 @@ class BufIO {
         if (bufpos>=buf.size()) return -1;
         else return buf[bufpos++];
       }
-      size_t GetBufPos(){return bufpos;};
+      size_t GetBufPos() const {return bufpos;};
+      void SetBufPos(size_t pos){bufpos=pos;};
       std::vector <uint8_t> &GetBuf(){return buf;};
+      const std::vector <uint8_t> &GetBuf() const {return buf;};
   private:
      size_t bufpos;
      std::vector <uint8_t>buf;
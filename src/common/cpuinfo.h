@@ -0,0 +1,38 @@
+#ifndef CPUINFO_H
+#define CPUINFO_H
+
+// runtime detection of the simd level, kernels built with target
+// attributes are picked by it, the binary itself needs no -mavx2
+namespace CPUInfo {
+
+enum tsimd {SIMD_NONE=0,SIMD_AVX2=1,SIMD_AVX512=2};
+
+inline tsimd Detect()
+{
+  #if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) return SIMD_AVX512;
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) return SIMD_AVX2;
+  #endif
+  return SIMD_NONE;
+}
+
+// detected once per process
+inline tsimd Level()
+{
+  static const tsimd level=Detect();
+  return level;
+}
+
+inline const char *Name(tsimd level)
+{
+  switch (level) {
+    case SIMD_AVX512:return "avx512";
+    case SIMD_AVX2:return "avx2";
+    default:return "scalar";
+  }
+}
+
+}
+
+#endif // CPUINFO_H
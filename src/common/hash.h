@@ -0,0 +1,49 @@
+#ifndef HASH_H
+#define HASH_H
+
+#include "md5.h"
+#include "xxhash.h"
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+
+// integrity hash over the pcm bytes: md5 (default, older files) or the
+// much faster xxh64. The digest is always 16 bytes as stored in the sac
+// header, xxh64 fills the first 8 and leaves the rest zero
+class AudioHash {
+  public:
+    enum Type {HASH_MD5,HASH_XXH64};
+    explicit AudioHash(Type type=HASH_MD5){Init(type);};
+    void Init(Type type)
+    {
+      this->type=type;
+      std::memset(digest,0,sizeof(digest));
+      if (type==HASH_XXH64) XXH64::Init(&xxhctx);
+      else MD5::Init(&md5ctx);
+    }
+    void Update(const uint8_t *input,size_t len)
+    {
+      if (type==HASH_XXH64) XXH64::Update(&xxhctx,input,len);
+      else MD5::Update(&md5ctx,input,len);
+    }
+    void Finalize()
+    {
+      if (type==HASH_XXH64) {
+        XXH64::Finalize(&xxhctx);
+        std::memcpy(digest,xxhctx.digest,8);
+      } else {
+        MD5::Finalize(&md5ctx);
+        std::memcpy(digest,md5ctx.digest,16);
+      }
+    }
+    Type GetType() const {return type;};
+    const char *Name() const {return type==HASH_XXH64?"XXH64":"MD5";};
+    int Size() const {return type==HASH_XXH64?8:16;}; // significant digest bytes
+    uint8_t digest[16];
+  private:
+    Type type;
+    MD5::MD5Context md5ctx;
+    XXH64::XXH64Context xxhctx;
+};
+
+#endif
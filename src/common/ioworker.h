@@ -0,0 +1,90 @@
+#ifndef IOWORKER_H
+#define IOWORKER_H
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+// one persistent thread for the io stages (block reads, write-behind,
+// hashing), tasks run in submission order. A task may wait on a later
+// one, Wait() then runs the queue inline on the io thread
+class IOWorker {
+  typedef std::function<void()> Task;
+  public:
+    IOWorker()
+    :done(false),worker([this]{WorkerLoop();})
+    {
+    }
+    ~IOWorker()
+    {
+      {
+        std::lock_guard<std::mutex> lock(mtx);
+        done=true;
+      }
+      cv.notify_all();
+      worker.join();
+    }
+
+    // process wide, started on first use
+    static IOWorker &Shared()
+    {
+      static IOWorker io;
+      return io;
+    }
+
+    template <class F>
+    auto Submit(F &&func) -> std::future<decltype(func())>
+    {
+      typedef decltype(func()) R;
+      auto task=std::make_shared<std::packaged_task<R()>>(std::forward<F>(func));
+      std::future<R> result=task->get_future();
+      {
+        std::lock_guard<std::mutex> lock(mtx);
+        tasks.emplace_back([task]{(*task)();});
+      }
+      cv.notify_one();
+      return result;
+    }
+
+    template <class T>
+    T Wait(std::future<T> &f)
+    {
+      if (std::this_thread::get_id()==worker.get_id())
+        while (f.wait_for(std::chrono::seconds(0))!=std::future_status::ready && RunPending());
+      return f.get();
+    }
+  private:
+    bool RunPending()
+    {
+      Task task;
+      {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (tasks.empty()) return false;
+        task=std::move(tasks.front());
+        tasks.pop_front();
+      }
+      task();
+      return true;
+    }
+    void WorkerLoop()
+    {
+      while (true) {
+        if (RunPending()) continue;
+        std::unique_lock<std::mutex> lock(mtx);
+        cv.wait(lock,[this]{return done || tasks.size();});
+        if (done && tasks.empty()) break;
+      }
+    }
+    std::mutex mtx;
+    std::condition_variable cv;
+    std::deque<Task> tasks;
+    bool done;
+    std::thread worker; // last, starts once the queue is set up
+};
+
+#endif // IOWORKER_H
@@ -54,13 +54,28 @@ void MD5::Init(MD5Context *ctx){
  * If the input fills out a block of 512 bits, apply the algorithm (md5Step)
  * and save the result in the buffer. Also updates the overall size.
  */
-void MD5::Update(MD5Context *ctx, uint8_t *input_buffer, size_t input_len){
+void MD5::Update(MD5Context *ctx, const uint8_t *input_buffer, size_t input_len){
     uint32_t input[16];
     unsigned int offset = ctx->size % 64;
     ctx->size += (uint64_t)input_len;
 
+    // Whole blocks straight from the input once the context buffer is empty
+    size_t start = 0;
+    if (offset == 0) {
+        for(; start + 64 <= input_len; start += 64){
+            const uint8_t *p = input_buffer + start;
+            for(unsigned int j = 0; j < 16; ++j){
+                input[j] = (uint32_t)(p[(j * 4) + 3]) << 24 |
+                           (uint32_t)(p[(j * 4) + 2]) << 16 |
+                           (uint32_t)(p[(j * 4) + 1]) <<  8 |
+                           (uint32_t)(p[(j * 4)]);
+            }
+            Step(ctx->buffer, input);
+        }
+    }
+
     // Copy each byte in input_buffer into the next space in our context input
-    for(unsigned int i = 0; i < input_len; ++i){
+    for(size_t i = start; i < input_len; ++i){
         ctx->input[offset++] = (uint8_t)*(input_buffer + i);
 
         // If we've filled our context input, copy it into our local array input
@@ -31,7 +31,7 @@ namespace MD5 {
  */
   uint32_t rotateLeft(uint32_t x, uint32_t n);
   void Init(MD5Context *ctx);
-  void Update(MD5Context *ctx, uint8_t *input, size_t input_len);
+  void Update(MD5Context *ctx, const uint8_t *input, size_t input_len);
   void Finalize(MD5Context *ctx);
   void Step(uint32_t *buffer, uint32_t *input);
 };
@@ -0,0 +1,709 @@
+#include "simd.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+  #define SIMD_X86
+  #include <immintrin.h>
+#endif
+
+namespace SIMD {
+
+// scalar, the 4 lanes of the avx2 sums are emulated with std::fma
+namespace scalar {
+
+static double dot(const double *x,const double *y,std::size_t n)
+{
+  double total=0.0;
+  std::size_t i=0;
+  if (n>=4) {
+    double sum[4]={0.0,0.0,0.0,0.0};
+    for (;i+4<=n;i+=4)
+      for (int k=0;k<4;k++) sum[k]=std::fma(x[i+k],y[i+k],sum[k]);
+    total=sum[0]+sum[1]+sum[2]+sum[3];
+  }
+  for (;i<n;i++) total=std::fma(x[i],y[i],total);
+  return total;
+}
+
+static double nlms_update(double *w,const double *x,const double *mutab,const double *powtab,double wgrad,int n,double &spow)
+{
+  double pred=0.0,sp=0.0;
+  int i=0;
+  if (n>=4) {
+    double sum_p[4]={0.0,0.0,0.0,0.0};
+    double sum_s[4]={0.0,0.0,0.0,0.0};
+    for (;i+4<=n;i+=4) {
+      for (int k=0;k<4;k++) {
+        const int j=i+k;
+        w[j]=std::fma(mutab[j],wgrad*x[j+1],w[j]);
+        sum_p[k]=std::fma(x[j],w[j],sum_p[k]);
+        sum_s[k]=std::fma(powtab[j],x[j]*x[j],sum_s[k]);
+      }
+    }
+    pred=sum_p[0]+sum_p[1]+sum_p[2]+sum_p[3];
+    sp=sum_s[0]+sum_s[1]+sum_s[2]+sum_s[3];
+  }
+  for (;i<n;i++) {
+    w[i]=std::fma(mutab[i],wgrad*x[i+1],w[i]);
+    pred=std::fma(x[i],w[i],pred);
+    sp=std::fma(powtab[i],x[i]*x[i],sp);
+  }
+  spow=sp;
+  return pred;
+}
+
+static void decay_add(double *dst,const double *src,double s,double lambda,double c0,int len)
+{
+  for (int i=0;i<len;i++) dst[i]=std::fma(lambda,dst[i],c0*(src[i]*s));
+}
+
+static void sub_mul(double *dst,const double *src,double s,int len)
+{
+  for (int i=0;i<len;i++) dst[i]=std::fma(-src[i],s,dst[i]);
+}
+
+static void div_by(double *dst,double d,int len)
+{
+  for (int i=0;i<len;i++) dst[i]=dst[i]/d;
+}
+
+static void rotate(double *l,double *v,double beta,double c,double s,int len)
+{
+  for (int i=0;i<len;i++) {
+    l[i]=std::fma(beta,l[i],s*v[i])/c;
+    v[i]=std::fma(c,v[i],-(s*l[i]));
+  }
+}
+
+// sequential, the same on every level
+static double sub_dot(double acc,const double *x,const double *y,int len)
+{
+  for (int i=0;i<len;i++) acc=std::fma(-x[i],y[i],acc);
+  return acc;
+}
+
+static int64_t sum_abs(const int32_t *buf,std::size_t n)
+{
+  int64_t sum=0;
+  for (std::size_t i=0;i<n;i++) sum+=std::abs(static_cast<int64_t>(buf[i]));
+  return sum;
+}
+
+static int64_t sum_sq(const int32_t *buf,std::size_t n)
+{
+  int64_t sum=0;
+  for (std::size_t i=0;i<n;i++) sum+=static_cast<int64_t>(buf[i])*buf[i];
+  return sum;
+}
+
+static void minmax(const int32_t *buf,std::size_t n,int32_t &vmin,int32_t &vmax)
+{
+  vmin=std::numeric_limits<int32_t>::max();
+  vmax=std::numeric_limits<int32_t>::min();
+  for (std::size_t i=0;i<n;i++) {
+    if (buf[i]<vmin) vmin=buf[i];
+    if (buf[i]>vmax) vmax=buf[i];
+  }
+}
+
+// one sample of csize bytes, see tkernels::deinterleave
+template <int csize> static inline int32_t get_sample(const uint8_t *p)
+{
+  switch (csize) {
+    case 1:return static_cast<int32_t>(p[0])-128;
+    case 2:return static_cast<int16_t>(p[0]|(p[1]<<8));
+    case 3:return static_cast<int32_t>((p[0]<<8)|(p[1]<<16)|(static_cast<uint32_t>(p[2])<<24))>>8;
+    default:return static_cast<int32_t>(p[0]|(p[1]<<8)|(p[2]<<16)|(static_cast<uint32_t>(p[3])<<24));
+  }
+}
+
+template <int csize> static inline void put_sample(uint8_t *p,int32_t val)
+{
+  const uint32_t v=static_cast<uint32_t>(csize==1?val+128:val);
+  for (int b=0;b<csize;b++) p[b]=static_cast<uint8_t>(v>>(8*b));
+}
+
+static inline int32_t get_sample(const uint8_t *p,int csize)
+{
+  switch (csize) {
+    case 1:return get_sample<1>(p);
+    case 2:return get_sample<2>(p);
+    case 3:return get_sample<3>(p);
+    default:return get_sample<4>(p);
+  }
+}
+
+template <int csize>
+static void deinterleave_n(const uint8_t *src,int32_t *const *dst,int numchannels,std::size_t from,std::size_t n)
+{
+  const uint8_t *p=src+from*numchannels*csize;
+  for (std::size_t i=from;i<n;i++)
+    for (int k=0;k<numchannels;k++,p+=csize) dst[k][i]=get_sample<csize>(p);
+}
+
+template <int csize>
+static void interleave_n(const int32_t *const *src,uint8_t *dst,int numchannels,std::size_t from,std::size_t n)
+{
+  uint8_t *p=dst+from*numchannels*csize;
+  for (std::size_t i=from;i<n;i++)
+    for (int k=0;k<numchannels;k++,p+=csize) put_sample<csize>(p,src[k][i]);
+}
+
+// frames [from,n), the simd versions finish their tails here
+static void deinterleave_from(const uint8_t *src,int32_t *const *dst,int numchannels,int csize,std::size_t from,std::size_t n)
+{
+  switch (csize) {
+    case 1:deinterleave_n<1>(src,dst,numchannels,from,n);break;
+    case 2:deinterleave_n<2>(src,dst,numchannels,from,n);break;
+    case 3:deinterleave_n<3>(src,dst,numchannels,from,n);break;
+    case 4:deinterleave_n<4>(src,dst,numchannels,from,n);break;
+  }
+}
+
+static void interleave_from(const int32_t *const *src,uint8_t *dst,int numchannels,int csize,std::size_t from,std::size_t n)
+{
+  switch (csize) {
+    case 1:interleave_n<1>(src,dst,numchannels,from,n);break;
+    case 2:interleave_n<2>(src,dst,numchannels,from,n);break;
+    case 3:interleave_n<3>(src,dst,numchannels,from,n);break;
+    case 4:interleave_n<4>(src,dst,numchannels,from,n);break;
+  }
+}
+
+static void deinterleave(const uint8_t *src,int32_t *const *dst,int numchannels,int csize,std::size_t n)
+{
+  deinterleave_from(src,dst,numchannels,csize,0,n);
+}
+
+static void interleave(const int32_t *const *src,uint8_t *dst,int numchannels,int csize,std::size_t n)
+{
+  interleave_from(src,dst,numchannels,csize,0,n);
+}
+
+// reflected polynomial 0x82f63b78, one table lookup per byte
+static const struct tcrc32c_tbl
+{
+  tcrc32c_tbl()
+  {
+    for (uint32_t i=0;i<256;i++) {
+      uint32_t c=i;
+      for (int k=0;k<8;k++) c=(c&1)?(c>>1)^0x82f63b78u:(c>>1);
+      tbl[i]=c;
+    }
+  }
+  uint32_t tbl[256];
+} crc32c_tbl;
+
+static uint32_t crc32c(uint32_t crc,const uint8_t *buf,std::size_t n)
+{
+  crc=~crc;
+  for (std::size_t i=0;i<n;i++) crc=crc32c_tbl.tbl[(crc^buf[i])&0xff]^(crc>>8);
+  return ~crc;
+}
+
+static const tkernels table={CPUInfo::SIMD_NONE,dot,nlms_update,decay_add,sub_mul,div_by,rotate,sub_dot,sum_abs,sum_sq,minmax,deinterleave,interleave,crc32c};
+
+}
+
+#ifdef SIMD_X86
+
+#define AVX2_FN __attribute__((target("avx2,fma")))
+#define AVX512_FN __attribute__((target("avx512f,avx2,fma")))
+
+namespace avx2 {
+
+AVX2_FN static inline double hsum(__m256d v)
+{
+  alignas(32) double buffer[4];
+  _mm256_store_pd(buffer,v);
+  return buffer[0]+buffer[1]+buffer[2]+buffer[3];
+}
+
+AVX2_FN static inline int64_t hsum(__m256i v)
+{
+  alignas(32) int64_t buffer[4];
+  _mm256_store_si256(reinterpret_cast<__m256i*>(buffer),v);
+  return buffer[0]+buffer[1]+buffer[2]+buffer[3];
+}
+
+AVX2_FN static double dot(const double *x,const double *y,std::size_t n)
+{
+  double total=0.0;
+  std::size_t i=0;
+  if (n>=4) {
+    __m256d sum=_mm256_setzero_pd();
+    for (;i+4<=n;i+=4)
+      sum=_mm256_fmadd_pd(_mm256_loadu_pd(x+i),_mm256_loadu_pd(y+i),sum);
+    total=hsum(sum);
+  }
+  for (;i<n;i++) total=std::fma(x[i],y[i],total);
+  return total;
+}
+
+AVX2_FN static double nlms_update(double *w,const double *x,const double *mutab,const double *powtab,double wgrad,int n,double &spow)
+{
+  double pred=0.0,sp=0.0;
+  int i=0;
+  if (n>=4) {
+    const __m256d vg=_mm256_set1_pd(wgrad);
+    __m256d sum_p=_mm256_setzero_pd();
+    __m256d sum_s=_mm256_setzero_pd();
+    for (;i+4<=n;i+=4) {
+      const __m256d vx=_mm256_loadu_pd(x+i);
+      const __m256d vx_old=_mm256_loadu_pd(x+i+1);
+      const __m256d vw=_mm256_fmadd_pd(_mm256_loadu_pd(mutab+i),_mm256_mul_pd(vg,vx_old),_mm256_loadu_pd(w+i));
+      _mm256_storeu_pd(w+i,vw);
+      sum_p=_mm256_fmadd_pd(vx,vw,sum_p);
+      sum_s=_mm256_fmadd_pd(_mm256_loadu_pd(powtab+i),_mm256_mul_pd(vx,vx),sum_s);
+    }
+    pred=hsum(sum_p);
+    sp=hsum(sum_s);
+  }
+  for (;i<n;i++) {
+    w[i]=std::fma(mutab[i],wgrad*x[i+1],w[i]);
+    pred=std::fma(x[i],w[i],pred);
+    sp=std::fma(powtab[i],x[i]*x[i],sp);
+  }
+  spow=sp;
+  return pred;
+}
+
+AVX2_FN static void decay_add(double *dst,const double *src,double s,double lambda,double c0,int len)
+{
+  const __m256d vl=_mm256_set1_pd(lambda);
+  const __m256d vc=_mm256_set1_pd(c0);
+  const __m256d vs=_mm256_set1_pd(s);
+  int i=0;
+  for (;i+4<=len;i+=4) {
+    const __m256d vp=_mm256_mul_pd(vc,_mm256_mul_pd(_mm256_loadu_pd(src+i),vs));
+    _mm256_storeu_pd(dst+i,_mm256_fmadd_pd(vl,_mm256_loadu_pd(dst+i),vp));
+  }
+  for (;i<len;i++) dst[i]=std::fma(lambda,dst[i],c0*(src[i]*s));
+}
+
+AVX2_FN static void sub_mul(double *dst,const double *src,double s,int len)
+{
+  const __m256d vs=_mm256_set1_pd(s);
+  int i=0;
+  for (;i+4<=len;i+=4)
+    _mm256_storeu_pd(dst+i,_mm256_fnmadd_pd(_mm256_loadu_pd(src+i),vs,_mm256_loadu_pd(dst+i)));
+  for (;i<len;i++) dst[i]=std::fma(-src[i],s,dst[i]);
+}
+
+AVX2_FN static void div_by(double *dst,double d,int len)
+{
+  const __m256d vd=_mm256_set1_pd(d);
+  int i=0;
+  for (;i+4<=len;i+=4)
+    _mm256_storeu_pd(dst+i,_mm256_div_pd(_mm256_loadu_pd(dst+i),vd));
+  for (;i<len;i++) dst[i]=dst[i]/d;
+}
+
+AVX2_FN static void rotate(double *l,double *v,double beta,double c,double s,int len)
+{
+  const __m256d vb=_mm256_set1_pd(beta);
+  const __m256d vc=_mm256_set1_pd(c);
+  const __m256d vs=_mm256_set1_pd(s);
+  int i=0;
+  for (;i+4<=len;i+=4) {
+    const __m256d vv=_mm256_loadu_pd(v+i);
+    const __m256d vl=_mm256_div_pd(_mm256_fmadd_pd(vb,_mm256_loadu_pd(l+i),_mm256_mul_pd(vs,vv)),vc);
+    _mm256_storeu_pd(l+i,vl);
+    _mm256_storeu_pd(v+i,_mm256_fmsub_pd(vc,vv,_mm256_mul_pd(vs,vl)));
+  }
+  for (;i<len;i++) {
+    l[i]=std::fma(beta,l[i],s*v[i])/c;
+    v[i]=std::fma(c,v[i],-(s*l[i]));
+  }
+}
+
+AVX2_FN static int64_t sum_abs(const int32_t *buf,std::size_t n)
+{
+  __m256i sum=_mm256_setzero_si256();
+  std::size_t i=0;
+  for (;i+4<=n;i+=4) {
+    const __m256i v=_mm256_cvtepi32_epi64(_mm_loadu_si128(reinterpret_cast<const __m128i*>(buf+i)));
+    const __m256i sign=_mm256_cmpgt_epi64(_mm256_setzero_si256(),v);
+    sum=_mm256_add_epi64(sum,_mm256_sub_epi64(_mm256_xor_si256(v,sign),sign));
+  }
+  int64_t total=hsum(sum);
+  for (;i<n;i++) total+=std::abs(static_cast<int64_t>(buf[i]));
+  return total;
+}
+
+AVX2_FN static int64_t sum_sq(const int32_t *buf,std::size_t n)
+{
+  __m256i sum=_mm256_setzero_si256();
+  std::size_t i=0;
+  for (;i+4<=n;i+=4) {
+    const __m256i v=_mm256_cvtepi32_epi64(_mm_loadu_si128(reinterpret_cast<const __m128i*>(buf+i)));
+    sum=_mm256_add_epi64(sum,_mm256_mul_epi32(v,v));
+  }
+  int64_t total=hsum(sum);
+  for (;i<n;i++) total+=static_cast<int64_t>(buf[i])*buf[i];
+  return total;
+}
+
+AVX2_FN static void minmax(const int32_t *buf,std::size_t n,int32_t &vmin,int32_t &vmax)
+{
+  vmin=std::numeric_limits<int32_t>::max();
+  vmax=std::numeric_limits<int32_t>::min();
+  std::size_t i=0;
+  if (n>=8) {
+    __m256i mn=_mm256_set1_epi32(vmin);
+    __m256i mx=_mm256_set1_epi32(vmax);
+    for (;i+8<=n;i+=8) {
+      const __m256i v=_mm256_loadu_si256(reinterpret_cast<const __m256i*>(buf+i));
+      mn=_mm256_min_epi32(mn,v);
+      mx=_mm256_max_epi32(mx,v);
+    }
+    alignas(32) int32_t bmin[8],bmax[8];
+    _mm256_store_si256(reinterpret_cast<__m256i*>(bmin),mn);
+    _mm256_store_si256(reinterpret_cast<__m256i*>(bmax),mx);
+    for (int k=0;k<8;k++) {
+      vmin=std::min(vmin,bmin[k]);
+      vmax=std::max(vmax,bmax[k]);
+    }
+  }
+  for (;i<n;i++) {
+    if (buf[i]<vmin) vmin=buf[i];
+    if (buf[i]>vmax) vmax=buf[i];
+  }
+}
+
+// 8 consecutive samples from p. 24 bit reads 32 bytes: bytes 0-11 go to
+// lane 0, 12-23 to lane 1, each sample to the top of its dword
+AVX2_FN static inline __m256i load8(const uint8_t *p,int csize)
+{
+  switch (csize) {
+    case 1:return _mm256_sub_epi32(_mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(p))),_mm256_set1_epi32(128));
+    case 2:return _mm256_cvtepi16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)));
+    case 3: {
+      const __m256i v=_mm256_permutevar8x32_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)),_mm256_setr_epi32(0,1,2,3,3,4,5,6));
+      const __m256i vshuf=_mm256_setr_epi8(-1,0,1,2,-1,3,4,5,-1,6,7,8,-1,9,10,11,
+                                           -1,0,1,2,-1,3,4,5,-1,6,7,8,-1,9,10,11);
+      return _mm256_srai_epi32(_mm256_shuffle_epi8(v,vshuf),8);
+    }
+    default:return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+  }
+}
+
+// decodes the interleaved stream 8 samples at a time, mono and stereo
+// split in registers, more channels with 24/32 bit go through a small buffer. The bound
+// j+11<=total keeps the 32 byte read of 24 bit inside the buffer
+AVX2_FN static void deinterleave(const uint8_t *src,int32_t *const *dst,int numchannels,int csize,std::size_t n)
+{
+  const std::size_t total=n*numchannels;
+  std::size_t j=0,i=0;
+  if (numchannels==1) {
+    for (;j+11<=total;j+=8)
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst[0]+j),load8(src+j*csize,csize));
+    i=j;
+  } else if (numchannels==2) {
+    const __m256i vsplit=_mm256_setr_epi32(0,2,4,6,1,3,5,7);
+    for (;j+11<=total;j+=8) {
+      const __m256i v=_mm256_permutevar8x32_epi32(load8(src+j*csize,csize),vsplit);
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(dst[0]+j/2),_mm256_castsi256_si128(v));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(dst[1]+j/2),_mm256_extracti128_si256(v,1));
+    }
+    i=j/2;
+  } else if (csize>=3) { // 8 and 16 bit are as fast in scalar
+    alignas(32) int32_t buf[8];
+    int k=0;
+    for (;j+11<=total;j+=8) {
+      _mm256_store_si256(reinterpret_cast<__m256i*>(buf),load8(src+j*csize,csize));
+      for (int t=0;t<8;t++) {
+        dst[k][i]=buf[t];
+        if (++k==numchannels) {k=0;i++;}
+      }
+    }
+    if (k) { // finish the partial frame
+      for (;k<numchannels;k++,j++) dst[k][i]=scalar::get_sample(src+j*csize,csize);
+      i++;
+    }
+  }
+  scalar::deinterleave_from(src,dst,numchannels,csize,i,n);
+}
+
+// 12 bytes from each 128 bit lane, writes 28
+AVX2_FN static inline void store24(uint8_t *p,__m256i v)
+{
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(p),_mm256_castsi256_si128(v));
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(p+12),_mm256_extracti128_si256(v,1));
+}
+
+// mono and stereo with 2 or 3 bytes, the rest is scalar. 24 bit packs 4
+// samples per 128 bit lane into 12 bytes and stores 16, the 4 extra bytes
+// land in the following frames and get overwritten, hence the slack
+AVX2_FN static void interleave(const int32_t *const *src,uint8_t *dst,int numchannels,int csize,std::size_t n)
+{
+  const __m256i vmask16=_mm256_set1_epi32(0xffff);
+  const __m256i vpack24=_mm256_setr_epi8(0,1,2,4,5,6,8,9,10,12,13,14,-1,-1,-1,-1,
+                                         0,1,2,4,5,6,8,9,10,12,13,14,-1,-1,-1,-1);
+  std::size_t i=0;
+  if (numchannels==1 && csize==2) {
+    for (;i+16<=n;i+=16) {
+      const __m256i a=_mm256_and_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(src[0]+i)),vmask16);
+      const __m256i b=_mm256_and_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(src[0]+i+8)),vmask16);
+      // packus works per 128 bit lane: a0-3 b0-3 | a4-7 b4-7
+      const __m256i v=_mm256_permute4x64_epi64(_mm256_packus_epi32(a,b),0xD8);
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst+2*i),v);
+    }
+  } else if (numchannels==1 && csize==3) {
+    for (;i+10<=n;i+=8) {
+      const __m256i v=_mm256_loadu_si256(reinterpret_cast<const __m256i*>(src[0]+i));
+      store24(dst+3*i,_mm256_shuffle_epi8(v,vpack24));
+    }
+  } else if (numchannels==2 && (csize==2 || csize==3)) {
+    for (;i+9<=n;i+=8) {
+      const __m256i l=_mm256_loadu_si256(reinterpret_cast<const __m256i*>(src[0]+i));
+      const __m256i r=_mm256_loadu_si256(reinterpret_cast<const __m256i*>(src[1]+i));
+      const __m256i lo=_mm256_unpacklo_epi32(l,r); // l0 r0 l1 r1 | l4 r4 l5 r5
+      const __m256i hi=_mm256_unpackhi_epi32(l,r); // l2 r2 l3 r3 | l6 r6 l7 r7
+      if (csize==2) {
+        const __m256i v=_mm256_packus_epi32(_mm256_and_si256(lo,vmask16),_mm256_and_si256(hi,vmask16));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst+4*i),v);
+      } else {
+        // frames 0-1 lo, 2-3 hi, 4-5 lo, 6-7 hi, 12 bytes each
+        const __m256i v0=_mm256_shuffle_epi8(_mm256_permute2x128_si256(lo,hi,0x20),vpack24);
+        const __m256i v1=_mm256_shuffle_epi8(_mm256_permute2x128_si256(lo,hi,0x31),vpack24);
+        store24(dst+6*i,v0);
+        store24(dst+6*i+24,v1);
+      }
+    }
+  }
+  scalar::interleave_from(src,dst,numchannels,csize,i,n);
+}
+
+// avx2 implies sse4.2
+AVX2_FN static uint32_t crc32c(uint32_t crc,const uint8_t *buf,std::size_t n)
+{
+  std::size_t i=0;
+  #ifdef __x86_64__
+    uint64_t c=~crc&0xffffffffu;
+    for (;i+8<=n;i+=8) {
+      uint64_t v;
+      std::memcpy(&v,buf+i,8);
+      c=_mm_crc32_u64(c,v);
+    }
+    crc=static_cast<uint32_t>(c);
+  #else
+    crc=~crc;
+  #endif
+  for (;i<n;i++) crc=_mm_crc32_u8(crc,buf[i]);
+  return ~crc;
+}
+
+static const tkernels table={CPUInfo::SIMD_AVX2,dot,nlms_update,decay_add,sub_mul,div_by,rotate,scalar::sub_dot,sum_abs,sum_sq,minmax,deinterleave,interleave,crc32c};
+
+}
+
+// 8 wide where lanes are independent, reductions keep the 4 lane order
+namespace avx512 {
+
+AVX512_FN static double dot(const double *x,const double *y,std::size_t n)
+{
+  double total=0.0;
+  std::size_t i=0;
+  if (n>=4) {
+    __m256d sum=_mm256_setzero_pd();
+    for (;i+8<=n;i+=8) {
+      sum=_mm256_fmadd_pd(_mm256_loadu_pd(x+i),_mm256_loadu_pd(y+i),sum);
+      sum=_mm256_fmadd_pd(_mm256_loadu_pd(x+i+4),_mm256_loadu_pd(y+i+4),sum);
+    }
+    if (i+4<=n) {
+      sum=_mm256_fmadd_pd(_mm256_loadu_pd(x+i),_mm256_loadu_pd(y+i),sum);
+      i+=4;
+    }
+    total=avx2::hsum(sum);
+  }
+  for (;i<n;i++) total=std::fma(x[i],y[i],total);
+  return total;
+}
+
+AVX512_FN static double nlms_update(double *w,const double *x,const double *mutab,const double *powtab,double wgrad,int n,double &spow)
+{
+  double pred=0.0,sp=0.0;
+  int i=0;
+  if (n>=4) {
+    const __m512d vg=_mm512_set1_pd(wgrad);
+    __m256d sum_p=_mm256_setzero_pd();
+    __m256d sum_s=_mm256_setzero_pd();
+    for (;i+8<=n;i+=8) {
+      const __m512d vx_old=_mm512_loadu_pd(x+i+1);
+      _mm512_storeu_pd(w+i,_mm512_fmadd_pd(_mm512_loadu_pd(mutab+i),_mm512_mul_pd(vg,vx_old),_mm512_loadu_pd(w+i)));
+      for (int k=0;k<8;k+=4) {
+        const __m256d vx=_mm256_loadu_pd(x+i+k);
+        sum_p=_mm256_fmadd_pd(vx,_mm256_loadu_pd(w+i+k),sum_p);
+        sum_s=_mm256_fmadd_pd(_mm256_loadu_pd(powtab+i+k),_mm256_mul_pd(vx,vx),sum_s);
+      }
+    }
+    if (i+4<=n) {
+      const __m256d vx=_mm256_loadu_pd(x+i);
+      const __m256d vx_old=_mm256_loadu_pd(x+i+1);
+      const __m256d vw=_mm256_fmadd_pd(_mm256_loadu_pd(mutab+i),_mm256_mul_pd(_mm256_set1_pd(wgrad),vx_old),_mm256_loadu_pd(w+i));
+      _mm256_storeu_pd(w+i,vw);
+      sum_p=_mm256_fmadd_pd(vx,vw,sum_p);
+      sum_s=_mm256_fmadd_pd(_mm256_loadu_pd(powtab+i),_mm256_mul_pd(vx,vx),sum_s);
+      i+=4;
+    }
+    pred=avx2::hsum(sum_p);
+    sp=avx2::hsum(sum_s);
+  }
+  for (;i<n;i++) {
+    w[i]=std::fma(mutab[i],wgrad*x[i+1],w[i]);
+    pred=std::fma(x[i],w[i],pred);
+    sp=std::fma(powtab[i],x[i]*x[i],sp);
+  }
+  spow=sp;
+  return pred;
+}
+
+AVX512_FN static void decay_add(double *dst,const double *src,double s,double lambda,double c0,int len)
+{
+  const __m512d vl=_mm512_set1_pd(lambda);
+  const __m512d vc=_mm512_set1_pd(c0);
+  const __m512d vs=_mm512_set1_pd(s);
+  int i=0;
+  for (;i+8<=len;i+=8) {
+    const __m512d vp=_mm512_mul_pd(vc,_mm512_mul_pd(_mm512_loadu_pd(src+i),vs));
+    _mm512_storeu_pd(dst+i,_mm512_fmadd_pd(vl,_mm512_loadu_pd(dst+i),vp));
+  }
+  for (;i<len;i++) dst[i]=std::fma(lambda,dst[i],c0*(src[i]*s));
+}
+
+AVX512_FN static void sub_mul(double *dst,const double *src,double s,int len)
+{
+  const __m512d vs=_mm512_set1_pd(s);
+  int i=0;
+  for (;i+8<=len;i+=8)
+    _mm512_storeu_pd(dst+i,_mm512_fnmadd_pd(_mm512_loadu_pd(src+i),vs,_mm512_loadu_pd(dst+i)));
+  for (;i<len;i++) dst[i]=std::fma(-src[i],s,dst[i]);
+}
+
+AVX512_FN static void div_by(double *dst,double d,int len)
+{
+  const __m512d vd=_mm512_set1_pd(d);
+  int i=0;
+  for (;i+8<=len;i+=8)
+    _mm512_storeu_pd(dst+i,_mm512_div_pd(_mm512_loadu_pd(dst+i),vd));
+  for (;i<len;i++) dst[i]=dst[i]/d;
+}
+
+AVX512_FN static void rotate(double *l,double *v,double beta,double c,double s,int len)
+{
+  const __m512d vb=_mm512_set1_pd(beta);
+  const __m512d vc=_mm512_set1_pd(c);
+  const __m512d vs=_mm512_set1_pd(s);
+  int i=0;
+  for (;i+8<=len;i+=8) {
+    const __m512d vv=_mm512_loadu_pd(v+i);
+    const __m512d vl=_mm512_div_pd(_mm512_fmadd_pd(vb,_mm512_loadu_pd(l+i),_mm512_mul_pd(vs,vv)),vc);
+    _mm512_storeu_pd(l+i,vl);
+    _mm512_storeu_pd(v+i,_mm512_fmsub_pd(vc,vv,_mm512_mul_pd(vs,vl)));
+  }
+  for (;i<len;i++) {
+    l[i]=std::fma(beta,l[i],s*v[i])/c;
+    v[i]=std::fma(c,v[i],-(s*l[i]));
+  }
+}
+
+// the integer cost and wav io kernels are memory bound, avx2 serves them
+static const tkernels table={CPUInfo::SIMD_AVX512,dot,nlms_update,decay_add,sub_mul,div_by,rotate,scalar::sub_dot,avx2::sum_abs,avx2::sum_sq,avx2::minmax,avx2::deinterleave,avx2::interleave,avx2::crc32c};
+
+}
+
+#endif
+
+// the legacy kernels below must not be contracted, whatever -m flags
+// the build uses
+#if defined(__clang__)
+  #pragma STDC FP_CONTRACT OFF
+  #define NOFMA_FN
+#elif defined(__GNUC__)
+  #define NOFMA_FN __attribute__((optimize("fp-contract=off")))
+#else
+  #define NOFMA_FN
+#endif
+
+// the predictor arithmetic of 'SAC2' streams from builds without fma:
+// the scalar code before runtime dispatch, one running sum per loop and
+// every product rounded before it is added
+namespace legacy {
+
+NOFMA_FN static double dot(const double *x,const double *y,std::size_t n)
+{
+  double sum=0.0;
+  for (std::size_t i=0;i<n;i++) sum+=x[i]*y[i];
+  return sum;
+}
+
+NOFMA_FN static double nlms_update(double *w,const double *x,const double *mutab,const double *powtab,double wgrad,int n,double &spow)
+{
+  double sp=0.0;
+  for (int i=0;i<n;i++) {
+    w[i]+=mutab[i]*(wgrad*x[i+1]);
+    sp+=powtab[i]*(x[i]*x[i]);
+  }
+  spow=sp;
+  return dot(x,w,n);
+}
+
+NOFMA_FN static void decay_add(double *dst,const double *src,double s,double lambda,double c0,int len)
+{
+  for (int i=0;i<len;i++) dst[i]=lambda*dst[i]+c0*(src[i]*s);
+}
+
+NOFMA_FN static void sub_mul(double *dst,const double *src,double s,int len)
+{
+  for (int i=0;i<len;i++) dst[i]-=(src[i]*s);
+}
+
+NOFMA_FN static void rotate(double *l,double *v,double beta,double c,double s,int len)
+{
+  for (int i=0;i<len;i++) {
+    l[i]=(beta*l[i]+s*v[i])/c;
+    v[i]=c*v[i]-s*l[i];
+  }
+}
+
+NOFMA_FN static double sub_dot(double acc,const double *x,const double *y,int len)
+{
+  for (int i=0;i<len;i++) acc-=(x[i]*y[i]);
+  return acc;
+}
+
+static const tkernels table={CPUInfo::SIMD_NONE,dot,nlms_update,decay_add,sub_mul,scalar::div_by,rotate,sub_dot,
+                             scalar::sum_abs,scalar::sum_sq,scalar::minmax,scalar::deinterleave,scalar::interleave,scalar::crc32c};
+
+}
+
+const tkernels &Legacy()
+{
+  return legacy::table;
+}
+
+const tkernels &Select(CPUInfo::tsimd level)
+{
+  #ifdef SIMD_X86
+    switch (level) {
+      case CPUInfo::SIMD_AVX512:return avx512::table;
+      case CPUInfo::SIMD_AVX2:return avx2::table;
+      default:break;
+    }
+  #else
+    (void)level;
+  #endif
+  return scalar::table;
+}
+
+// constant initialized, so users during static initialization get the
+// scalar table, which gives the same results. Switched to the best
+// table by the dynamic initializer below
+constinit const tkernels *kernels=&scalar::table;
+[[maybe_unused]] static const bool kernels_selected=(kernels=&Select(CPUInfo::Level()),true);
+
+}
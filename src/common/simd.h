@@ -0,0 +1,63 @@
+#ifndef SIMD_H
+#define SIMD_H
+
+#include <cstddef>
+#include <cstdint>
+#include "cpuinfo.h"
+
+// hot loops, one table per simd level, picked once at startup by
+// CPUInfo::Level(). Floating point kernels use explicit fma and sum in 4
+// lanes like the avx2 dot, every level gives bit-identical results,
+// a stream coded on one cpu decodes on any other
+namespace SIMD {
+
+struct tkernels {
+  CPUInfo::tsimd level;
+
+  // sum x[i]*y[i]
+  double (*dot)(const double *x,const double *y,std::size_t n);
+
+  // fused nlms step, one pass over the taps:
+  //   w[i]=fma(mutab[i],wgrad*x[i+1],w[i])   (x[1..n] is the old input)
+  //   returns dot(x[0..n-1],w), spow=sum powtab[i]*x[i]^2
+  // x must hold n+1 values
+  double (*nlms_update)(double *w,const double *x,const double *mutab,const double *powtab,double wgrad,int n,double &spow);
+
+  // ols: dst=fma(lambda,dst,c0*(src*s))
+  void (*decay_add)(double *dst,const double *src,double s,double lambda,double c0,int len);
+  // ols: dst=fma(-src,s,dst)
+  void (*sub_mul)(double *dst,const double *src,double s,int len);
+  // ols: dst=dst/d
+  void (*div_by)(double *dst,double d,int len);
+  // ols: l=fma(beta,l,s*v)/c, v=fma(c,v,-s*l)
+  void (*rotate)(double *l,double *v,double beta,double c,double s,int len);
+  // ols: acc=fma(-x[i],y[i],acc) in order, returns acc
+  double (*sub_dot)(double acc,const double *x,const double *y,int len);
+
+  // cost functions
+  int64_t (*sum_abs)(const int32_t *buf,std::size_t n);
+  int64_t (*sum_sq)(const int32_t *buf,std::size_t n);
+  void (*minmax)(const int32_t *buf,std::size_t n,int32_t &vmin,int32_t &vmax);
+
+  // wav io: n frames of interleaved little endian samples, csize bytes each
+  // <-> one plane per channel. 1 byte is unsigned (offset 128), 2-3 bytes
+  // are sign extended, 4 bytes taken as is. Interleave keeps the low bytes
+  void (*deinterleave)(const uint8_t *src,int32_t *const *dst,int numchannels,int csize,std::size_t n);
+  void (*interleave)(const int32_t *const *src,uint8_t *dst,int numchannels,int csize,std::size_t n);
+
+  // crc32c (castagnoli) of buf continuing crc, start with 0.
+  // The avx2 level uses the sse4.2 crc32 instruction
+  uint32_t (*crc32c)(uint32_t crc,const uint8_t *buf,std::size_t n);
+};
+
+const tkernels &Select(CPUInfo::tsimd level);
+
+// 'SAC2' streams of builds without fma: sequential sums, separate
+// mul/add, for bit-exact decoding only
+const tkernels &Legacy();
+
+extern const tkernels *kernels; // best table for this cpu, scalar until selected
+
+}
+
+#endif // SIMD_H
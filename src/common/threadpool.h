@@ -0,0 +1,179 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// work-stealing thread pool
+// every worker owns a deque: it pops its own tasks lifo and steals fifo
+// from the others. Tasks may wait on tasks they spawned, Wait() keeps
+// running queued work meanwhile, so nesting can not starve the pool
+class ThreadPool {
+  typedef std::function<void()> Task;
+  struct Queue {
+    std::mutex mtx;
+    std::deque<Task> tasks;
+  };
+  public:
+    explicit ThreadPool(int num_threads)
+    :queues(std::max(1,num_threads)),next(0),pending(0),done(false)
+    {
+      for (std::size_t i=0;i<queues.size();i++)
+        workers.emplace_back([this,i]{WorkerLoop(i);});
+    }
+    ~ThreadPool()
+    {
+      {
+        std::lock_guard<std::mutex> lock(mtx_wait);
+        done=true;
+      }
+      cv_wait.notify_all();
+      for (auto &worker:workers) worker.join();
+    }
+    int NumThreads() const {return static_cast<int>(workers.size());};
+
+    // process wide pool, sized by the first call (def: all cores)
+    static ThreadPool &Shared(int num_threads=0)
+    {
+      static ThreadPool pool(num_threads>0?num_threads:std::max(1u,std::thread::hardware_concurrency()));
+      return pool;
+    }
+
+    // run func(0..n-1), index 0 on the calling thread
+    template <class F>
+    void ParallelFor(int n,F func)
+    {
+      std::vector<std::future<void>> tasks;
+      for (int i=1;i<n;i++) tasks.push_back(Submit([&func,i]{func(i);}));
+      if (n>0) func(0);
+      for (auto &task:tasks) Wait(task);
+    }
+
+    template <class F>
+    auto Submit(F &&func) -> std::future<decltype(func())>
+    {
+      typedef decltype(func()) R;
+      auto task=std::make_shared<std::packaged_task<R()>>(std::forward<F>(func));
+      std::future<R> result=task->get_future();
+
+      // workers keep their own spawn local, others are spread round robin
+      const int self=WorkerIdx();
+      const std::size_t idx=(self>=0)?self:(next++%queues.size());
+      {
+        std::lock_guard<std::mutex> lock(mtx_wait);
+        pending++;
+      }
+      {
+        std::lock_guard<std::mutex> lock(queues[idx].mtx);
+        queues[idx].tasks.emplace_back([task]{(*task)();});
+      }
+      cv_wait.notify_one();
+      return result;
+    }
+
+    // run one queued task on the calling thread, false if there was none
+    bool RunPending()
+    {
+      Task task;
+      if (!Pop(task)) return false;
+      task();
+      return true;
+    }
+
+    // block on f, meanwhile a worker runs tasks from its own queue: these
+    // were spawned by it, which keeps nested waits shallow and deadlock free
+    template <class T>
+    T Wait(std::future<T> &f)
+    {
+      while (f.wait_for(std::chrono::seconds(0))!=std::future_status::ready) {
+        if (!RunLocal()) f.wait_for(std::chrono::microseconds(200));
+      }
+      return f.get();
+    }
+  private:
+    struct tworker {
+      const ThreadPool *pool=nullptr;
+      int idx=-1;
+    };
+    static tworker &CurrentWorker()
+    {
+      static thread_local tworker worker;
+      return worker;
+    }
+    // index of the calling thread in this pool, -1 for outside threads
+    int WorkerIdx() const
+    {
+      const tworker &worker=CurrentWorker();
+      return (worker.pool==this)?worker.idx:-1;
+    }
+    bool RunLocal()
+    {
+      Task task;
+      if (!PopLocal(task)) return false;
+      task();
+      return true;
+    }
+    bool PopLocal(Task &task)
+    {
+      const int self=WorkerIdx();
+      if (self<0) return false;
+      Queue &q=queues[self]; // newest task first
+      std::lock_guard<std::mutex> lock(q.mtx);
+      if (q.tasks.empty()) return false;
+      task=std::move(q.tasks.back());
+      q.tasks.pop_back();
+      return Taken();
+    }
+    bool Pop(Task &task)
+    {
+      const int self=WorkerIdx();
+      const std::size_t n=queues.size();
+      if (PopLocal(task)) return true;
+      const std::size_t start=(self>=0)?self+1:0;
+      for (std::size_t k=0;k<n;k++) { // steal oldest
+        Queue &q=queues[(start+k)%n];
+        std::lock_guard<std::mutex> lock(q.mtx);
+        if (q.tasks.size()) {
+          task=std::move(q.tasks.front());
+          q.tasks.pop_front();
+          return Taken();
+        }
+      }
+      return false;
+    }
+    bool Taken()
+    {
+      std::lock_guard<std::mutex> lock(mtx_wait);
+      pending--;
+      return true;
+    }
+    void WorkerLoop(std::size_t idx)
+    {
+      CurrentWorker().pool=this;
+      CurrentWorker().idx=static_cast<int>(idx);
+      while (true) {
+        if (RunPending()) continue;
+        std::unique_lock<std::mutex> lock(mtx_wait);
+        cv_wait.wait(lock,[this]{return done || pending>0;});
+        if (done && pending==0) break;
+      }
+    }
+    std::vector<Queue> queues;
+    std::vector<std::thread> workers;
+    std::atomic<std::size_t> next;
+    std::mutex mtx_wait;
+    std::condition_variable cv_wait;
+    std::size_t pending;
+    bool done;
+};
+
+#endif // THREADPOOL_H
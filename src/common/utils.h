@@ -7,11 +7,7 @@
 #include <string>
 #include <cmath>
 
-#if defined(__x86_64__) || defined(__i386__)
-#ifndef __ANDROID__
-#include <immintrin.h>
-#endif
-#endif
+#include "simd.h"
 
 // running exponential smoothing
 // sum=alpha*sum+(1.0-alpha)*val, where 1/(1-alpha) is the mean number of samples considered
@@ -115,59 +111,11 @@ namespace StrUtils {
 
 namespace MathUtils {
 
-#if defined(USE_AVX512)
+// 4 fma lanes on every cpu, see simd.h
 inline double dot(const double* x,const double* y, std::size_t n)
 {
-  __m512d sum = _mm512_setzero_pd();
-
-  std::size_t i = 0;
-  for (;i+8 <= n;i+=8)
-  {
-    __m512d vx = _mm512_loadu_pd(&x[i]);
-    __m512d vy = _mm512_loadu_pd(&y[i]);
-    sum = _mm512_fmadd_pd(vx, vy, sum);
-  }
-
-  double total = _mm512_reduce_add_pd(sum);
-
-  for (;i<n;++i)
-      total += x[i] * y[i];
-
-  return total;
-}
-#elif defined(USE_AVX256)
-
-inline double dot(const double* x,const double* y, std::size_t n)
-{
-  double total=0.0;
-  std::size_t i=0;
-  if (n>=4)
-  {
-    __m256d sum = _mm256_setzero_pd();
-    for (;i + 4 <= n;i += 4)
-    {
-      __m256d vx = _mm256_loadu_pd(&x[i]);
-      __m256d vy = _mm256_loadu_pd(&y[i]);
-      sum = _mm256_fmadd_pd(vx, vy, sum);
-    }
-
-    alignas(32) double buffer[4];
-    _mm256_storeu_pd(buffer, sum);
-    total = buffer[0] + buffer[1] + buffer[2] + buffer[3];
-  }
-  for (; i < n; ++i)
-    total += x[i] * y[i];
-  return total;
-}
-#else
-inline double dot(const double* x,const double* y, std::size_t n)
-{
-  double sum=0.0;
-  for (std::size_t i=0;i<n;i++)
-    sum+=x[i]*y[i];
-  return sum;
+  return SIMD::kernels->dot(x,y,n);
 }
-#endif
 
 
 class Cholesky
@@ -0,0 +1,99 @@
+#include "xxhash.h"
+#include <algorithm>
+#include <cstring>
+
+static const uint64_t P1=0x9E3779B185EBCA87ULL;
+static const uint64_t P2=0xC2B2AE3D27D4EB4FULL;
+static const uint64_t P3=0x165667B19E3779F9ULL;
+static const uint64_t P4=0x85EBCA77C2B2AE63ULL;
+static const uint64_t P5=0x27D4EB2F165667C5ULL;
+
+static inline uint64_t rotl64(uint64_t x,int n) {return (x<<n)|(x>>(64-n));}
+static inline uint64_t read64(const uint8_t *p) {uint64_t v;std::memcpy(&v,p,8);return v;} // little endian host
+static inline uint32_t read32(const uint8_t *p) {uint32_t v;std::memcpy(&v,p,4);return v;}
+
+static inline uint64_t xxround(uint64_t acc,uint64_t input)
+{
+  acc+=input*P2;
+  acc=rotl64(acc,31);
+  return acc*P1;
+}
+
+static inline uint64_t xxmerge(uint64_t acc,uint64_t val)
+{
+  acc^=xxround(0,val);
+  return acc*P1+P4;
+}
+
+// consumes whole 32 byte stripes, returns the bytes used
+static size_t xxstripes(uint64_t *acc,const uint8_t *p,size_t len)
+{
+  uint64_t v0=acc[0],v1=acc[1],v2=acc[2],v3=acc[3];
+  size_t pos=0;
+  for (;pos+32<=len;pos+=32) {
+    v0=xxround(v0,read64(p+pos));
+    v1=xxround(v1,read64(p+pos+8));
+    v2=xxround(v2,read64(p+pos+16));
+    v3=xxround(v3,read64(p+pos+24));
+  }
+  acc[0]=v0;acc[1]=v1;acc[2]=v2;acc[3]=v3;
+  return pos;
+}
+
+void XXH64::Init(XXH64Context *ctx)
+{
+  ctx->total=0;
+  ctx->acc[0]=P1+P2;
+  ctx->acc[1]=P2;
+  ctx->acc[2]=0;
+  ctx->acc[3]=0-P1;
+  ctx->memsize=0;
+}
+
+void XXH64::Update(XXH64Context *ctx, const uint8_t *input, size_t input_len)
+{
+  ctx->total+=input_len;
+  if (ctx->memsize) { // complete the pending stripe first
+    const size_t n=std::min<size_t>(32-ctx->memsize,input_len);
+    std::memcpy(ctx->mem+ctx->memsize,input,n);
+    ctx->memsize+=n;
+    input+=n;input_len-=n;
+    if (ctx->memsize<32) return;
+    xxstripes(ctx->acc,ctx->mem,32);
+    ctx->memsize=0;
+  }
+  const size_t used=xxstripes(ctx->acc,input,input_len);
+  ctx->memsize=input_len-used;
+  std::memcpy(ctx->mem,input+used,ctx->memsize);
+}
+
+void XXH64::Finalize(XXH64Context *ctx)
+{
+  uint64_t h;
+  if (ctx->total>=32) {
+    const uint64_t *v=ctx->acc;
+    h=rotl64(v[0],1)+rotl64(v[1],7)+rotl64(v[2],12)+rotl64(v[3],18);
+    for (int i=0;i<4;i++) h=xxmerge(h,v[i]);
+  } else h=P5;
+  h+=ctx->total;
+
+  const uint8_t *p=ctx->mem;
+  uint32_t len=ctx->memsize;
+  for (;len>=8;p+=8,len-=8) {
+    h^=xxround(0,read64(p));
+    h=rotl64(h,27)*P1+P4;
+  }
+  if (len>=4) {
+    h^=static_cast<uint64_t>(read32(p))*P1;
+    h=rotl64(h,23)*P2+P3;
+    p+=4;len-=4;
+  }
+  for (;len>0;p++,len--) {
+    h^=(*p)*P5;
+    h=rotl64(h,11)*P1;
+  }
+  h^=h>>33;h*=P2;
+  h^=h>>29;h*=P3;
+  h^=h>>32;
+  for (int i=0;i<8;i++) ctx->digest[i]=static_cast<uint8_t>(h>>(56-8*i));
+}
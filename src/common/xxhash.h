@@ -0,0 +1,22 @@
+#ifndef XXHASH_H
+#define XXHASH_H
+
+#include <cstdint>
+#include <cstddef>
+
+// streaming xxh64 (seed 0), digest is the canonical big endian form
+namespace XXH64 {
+  typedef struct{
+    uint64_t total;       // bytes seen so far
+    uint64_t acc[4];      // lane accumulators
+    uint8_t mem[32];      // pending input, less than one stripe
+    uint32_t memsize;
+    uint8_t digest[8];
+  } XXH64Context;
+
+  void Init(XXH64Context *ctx);
+  void Update(XXH64Context *ctx, const uint8_t *input, size_t input_len);
+  void Finalize(XXH64Context *ctx);
+};
+
+#endif
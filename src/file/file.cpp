@@ -1,5 +1,44 @@
 #include "file.h"
 
+#if defined(__unix__) || defined(__APPLE__)
+  #define HAVE_MMAP
+  #include <fcntl.h>
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+  #include <unistd.h>
+#endif
+
+bool FileMap::Map(const std::string &fname)
+{
+  Unmap();
+  #ifdef HAVE_MMAP
+    const int fd=open(fname.c_str(),O_RDONLY);
+    if (fd<0) return false;
+    struct stat st;
+    if (fstat(fd,&st)==0 && S_ISREG(st.st_mode) && st.st_size>0) {
+      void *p=mmap(nullptr,static_cast<std::size_t>(st.st_size),PROT_READ,MAP_PRIVATE,fd,0);
+      if (p!=MAP_FAILED) {
+        madvise(p,static_cast<std::size_t>(st.st_size),MADV_SEQUENTIAL);
+        ptr=static_cast<const uint8_t*>(p);
+        len=static_cast<std::size_t>(st.st_size);
+      }
+    }
+    close(fd); // the mapping keeps the file
+  #else
+    (void)fname;
+  #endif
+  return ptr!=nullptr;
+}
+
+void FileMap::Unmap()
+{
+  #ifdef HAVE_MMAP
+    if (ptr) munmap(const_cast<uint8_t*>(ptr),len);
+  #endif
+  ptr=nullptr;
+  len=0;
+}
+
 std::streampos AudioFile::readFileSize()
 {
     std::streampos oldpos=file.tellg();
@@ -11,16 +50,38 @@ std::streampos AudioFile::readFileSize()
 
 int AudioFile::OpenRead(const std::string &fname)
 {
-    file.open(fname,std::ios_base::in|std::ios_base::binary);
-    if (file.is_open()) {filesize=readFileSize();return 0;}
-    else return 1;
+    if (fbuf.open(fname,std::ios_base::in|std::ios_base::binary)) {
+      file.rdbuf(&fbuf);
+      filesize=readFileSize();
+      fmap.Map(fname);
+      return 0;
+    } else return 1;
 }
 
 int AudioFile::OpenWrite(const std::string &fname)
 {
-  file.open(fname,std::ios_base::out|std::ios_base::binary);
-  if (file.is_open()) return 0;
-  else return 1;
+  if (fbuf.open(fname,std::ios_base::out|std::ios_base::binary)) {
+    file.rdbuf(&fbuf);
+    return 0;
+  } else return 1;
+}
+
+int AudioFile::OpenUpdate(const std::string &fname)
+{
+  if (fbuf.open(fname,std::ios_base::in|std::ios_base::out|std::ios_base::binary)) {
+    file.rdbuf(&fbuf);
+    filesize=readFileSize();
+    return 0;
+  } else return 1;
+}
+
+int AudioFile::OpenStream(std::streambuf *buf)
+{
+  if (buf==nullptr) return 1;
+  file.rdbuf(buf);
+  streamed=true;
+  filesize=0;
+  return 0;
 }
 
 void AudioFile::ReadData(std::vector <uint8_t>&data,size_t len)
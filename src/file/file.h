@@ -6,32 +6,60 @@
 #include <string>
 #include <vector>
 #include <fstream>
+#include <iostream>
 #include <cstdint>
 
+// read-only mapping of a whole file, stays empty where mmap is not
+// available or fails, readers then fall back to the stream
+class FileMap
+{
+  public:
+    FileMap():ptr(nullptr),len(0){};
+    FileMap(const FileMap &)=delete;
+    FileMap &operator=(const FileMap &)=delete;
+    ~FileMap(){Unmap();};
+    bool Map(const std::string &fname);
+    void Unmap();
+    const uint8_t *data() const {return ptr;};
+    std::size_t size() const {return len;};
+  private:
+    const uint8_t *ptr;
+    std::size_t len;
+};
+
 class AudioFile
 {
   public:
-    AudioFile():samplerate(0),bitspersample(0),numchannels(0),numsamples(0),kbps(0){};
+    AudioFile():file(nullptr),filesize(0),streamed(false),samplerate(0),bitspersample(0),numchannels(0),numsamples(0),kbps(0),floatpcm(false){};
     AudioFile(const AudioFile &file)
-    :samplerate(file.getSampleRate()),bitspersample(file.getBitsPerSample()),
-    numchannels(file.getNumChannels()),numsamples(file.getNumSamples()),kbps(0){};
+    :file(nullptr),filesize(0),streamed(false),samplerate(file.getSampleRate()),bitspersample(file.getBitsPerSample()),
+    numchannels(file.getNumChannels()),numsamples(file.getNumSamples()),kbps(0),floatpcm(file.isFloat()){};
 
     int OpenRead(const std::string &fname);
     int OpenWrite(const std::string &fname);
+    int OpenUpdate(const std::string &fname); // read/write, keeps the content
+    int OpenStream(std::streambuf *buf); // non-seekable, e.g. stdin/stdout
+    bool isStreamed() const {return streamed;};
     std::streampos getFileSize() const {return filesize;};
     int getNumChannels()const {return numchannels;};
     int getSampleRate()const {return samplerate;};
     int getBitsPerSample()const {return bitspersample;};
+    bool isFloat()const {return floatpcm;}; // ieee float samples
     int getKBPS()const {return kbps;};
     void setKBPS(int kbps) {this->kbps=kbps;};
     int getNumSamples()const {return numsamples;};
+    void setNumSamples(int numsamples) {this->numsamples=numsamples;};
     std::streampos readFileSize();
-    void Close() {if (file.is_open()) file.close();};
+    void Close() {file.flush();if (fbuf.is_open()) fbuf.close();fmap.Unmap();};
     void ReadData(std::vector <uint8_t>&data,size_t len);
     void WriteData(const std::vector <uint8_t>&data,size_t len);
-    std::fstream file;
+    std::iostream file;
   protected:
+    std::filebuf fbuf;
+    FileMap fmap; // input files only
     std::streampos filesize;
+    bool streamed;
     int samplerate,bitspersample,numchannels,numsamples,kbps;
+    bool floatpcm;
 };
 #endif // FILE_H
@@ -22,13 +22,14 @@ int Sac::WriteSACHeader(Wav &myWav)
   buf[0]='S';
   buf[1]='A';
   buf[2]='C';
-  buf[3]='2';
+  buf[3]='0'+FORMAT;
   BitUtils::put16LH(buf+4,numchannels);
   BitUtils::put32LH(buf+6,samplerate);
   BitUtils::put16LH(buf+10,bitspersample);
   BitUtils::put32LH(buf+12,numsamples);
   buf[16] = mcfg.max_framelen;
-  buf[17] = 0;
+  if (floatpcm) mcfg.flags|=FLOATPCM;
+  buf[17] = mcfg.flags;
 
   // write wav meta data
   const uint32_t metadatasize=myChunks.GetMetaDataSize();
@@ -50,15 +51,112 @@ int Sac::ReadSACHeader()
 {
   uint8_t buf[32];
   file.read((char*)buf,22);
-  if (buf[0]=='S' && buf[1]=='A' && buf[2]=='C' && buf[3]=='2') {
+  if (buf[0]=='S' && buf[1]=='A' && buf[2]=='C' && (buf[3]=='2' || buf[3]=='0'+FORMAT)) {
+    mcfg.format=buf[3]-'0';
     numchannels=BitUtils::get16LH(buf+4);
     samplerate=BitUtils::get32LH(buf+6);
     bitspersample=BitUtils::get16LH(buf+10);
     numsamples=BitUtils::get32LH(buf+12);
     mcfg.max_framelen=buf[16];
+    mcfg.flags=buf[17];
+    floatpcm=(mcfg.flags&FLOATPCM)!=0;
     mcfg.metadatasize=BitUtils::get32LH(buf+18);
     ReadData(metadata,mcfg.metadatasize);
     mcfg.max_framesize=samplerate*static_cast<uint32_t>(mcfg.max_framelen);
+    if ((mcfg.flags&STREAMED) && !streamed) {
+      // seekable copy of a streamed file, pick up the trailer directly
+      const std::streampos oldpos=file.tellg();
+      file.seekg(getFileSize()-std::streamoff(20));
+      if (ReadTrailer()!=0) std::cerr << "  warning: invalid trailer\n";
+      file.clear();
+      file.seekg(oldpos);
+    }
+    if ((mcfg.flags&SEEKTABLE) && !streamed) {
+      if (ReadSeekTable()!=0) std::cerr << "  warning: invalid seek table\n";
+    }
     return 0;
   } else return 1;
 }
+
+// streamed files end with a zero-length frame followed by
+// numsamples and the md5 digest, as neither is known up front
+int Sac::WriteTrailer(const uint8_t digest[16])
+{
+  uint8_t buf[24];
+  BitUtils::put32LH(buf,0);
+  BitUtils::put32LH(buf+4,numsamples);
+  std::copy(digest,digest+16,buf+8);
+  file.write(reinterpret_cast<char*>(buf),24);
+  return 0;
+}
+
+// reads numsamples and digest, the end-of-frames marker is already consumed
+int Sac::ReadTrailer()
+{
+  uint8_t buf[20];
+  if (!file.read(reinterpret_cast<char*>(buf),20)) return 1;
+  numsamples=BitUtils::get32LH(buf);
+  std::copy(buf+4,buf+20,trailer_digest);
+  return 0;
+}
+
+// seek table layout (after the last frame):
+// 'SEEK', numentries, numentries*(pos lo, pos hi, start, numsamples), tablesize
+int Sac::WriteSeekTable()
+{
+  const uint64_t tablesize=12+static_cast<uint64_t>(seektable.size())*16;
+  if (tablesize>UINT32_MAX) return 1;
+  std::vector <uint8_t>buf(tablesize);
+  BitUtils::put32LH(&buf[0],0x4b454553);
+  BitUtils::put32LH(&buf[4],seektable.size());
+  size_t ofs=8;
+  for (const auto &entry:seektable) {
+    BitUtils::put32LH(&buf[ofs],static_cast<uint32_t>(entry.pos));
+    BitUtils::put32LH(&buf[ofs+4],static_cast<uint32_t>(entry.pos>>32));
+    BitUtils::put32LH(&buf[ofs+8],entry.start);
+    BitUtils::put32LH(&buf[ofs+12],entry.numsamples);
+    ofs+=16;
+  }
+  BitUtils::put32LH(&buf[ofs],static_cast<uint32_t>(tablesize));
+  WriteData(buf,tablesize);
+  return 0;
+}
+
+// reads the table from the end of the file, the file position is kept
+int Sac::ReadSeekTable()
+{
+  seektable.clear();
+  const std::streampos oldpos=file.tellg();
+  const std::streamoff fsize=getFileSize();
+  int ret=1;
+
+  uint8_t buf[16];
+  if (fsize>=12 && file.seekg(fsize-4) && file.read(reinterpret_cast<char*>(buf),4)) {
+    const uint32_t tablesize=BitUtils::get32LH(buf);
+    if (tablesize>=12 && tablesize<=fsize && file.seekg(fsize-tablesize) && file.read(reinterpret_cast<char*>(buf),8)) {
+      // in 64 bit and bounded by the file, a damaged count can't wrap
+      const uint32_t numentries=BitUtils::get32LH(buf+4);
+      if (BitUtils::get32LH(buf)==0x4b454553 && numentries<=static_cast<uint64_t>(fsize-12)/16
+          && tablesize==12+static_cast<uint64_t>(numentries)*16) {
+        // no checksum: entries must be frames that fit the coder, back to
+        // back from sample 0 and inside the file
+        seektable.resize(numentries);
+        bool valid=true;
+        uint64_t nextstart=0;
+        for (auto &entry:seektable) {
+          file.read(reinterpret_cast<char*>(buf),16);
+          entry.pos=BitUtils::get32LH(buf)|(static_cast<uint64_t>(BitUtils::get32LH(buf+4))<<32);
+          entry.start=BitUtils::get32LH(buf+8);
+          entry.numsamples=BitUtils::get32LH(buf+12);
+          if (entry.numsamples>mcfg.max_framesize || entry.start!=nextstart || entry.pos>=static_cast<uint64_t>(fsize)) valid=false;
+          nextstart=static_cast<uint64_t>(entry.start)+entry.numsamples;
+        }
+        if (file && valid) ret=0;
+        else seektable.clear();
+      }
+    }
+  }
+  file.clear();
+  file.seekg(oldpos);
+  return ret;
+}
@@ -12,9 +12,21 @@ struct tFrameHeader {
 class Sac : public AudioFile
 {
   public:
+    enum hdr_flags {SEEKTABLE=1,STREAMED=2,FLOATPCM=4,XXHASH=8,FRAMECRC=16};
+    // stream format in the magic 'SACn'. 3: the predictors use fused
+    // multiply-add on every path. 2: separate mul/add (SIMD::Legacy), or
+    // fused if an fma build wrote it, which the header doesn't tell
+    static const uint8_t FORMAT=3;
+    struct tseek_entry {
+      uint64_t pos=0;       // byte offset of the frame
+      uint32_t start=0;     // first sample
+      uint32_t numsamples=0;
+    };
     struct sac_cfg
     {
+      uint8_t format=FORMAT;
       uint8_t max_framelen=0;
+      uint8_t flags=0;
 
       uint32_t max_framesize=0;
       uint32_t metadatasize=0;
@@ -31,7 +43,14 @@ class Sac : public AudioFile
     std::streamsize ReadMD5(uint8_t digest[16]);
     int ReadSACHeader();
     int UnpackMetaData(Wav &myWav);
+    int WriteSeekTable();
+    int ReadSeekTable();
+    int WriteTrailer(const uint8_t digest[16]);
+    int ReadTrailer();
+    AudioHash::Type GetHashType() const {return (mcfg.flags&XXHASH)?AudioHash::HASH_XXH64:AudioHash::HASH_MD5;};
     std::vector <uint8_t>metadata;
+    std::vector <tseek_entry>seektable;
+    uint8_t trailer_digest[16]={0};
 };
 
 
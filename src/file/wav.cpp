@@ -1,8 +1,12 @@
 #include "wav.h"
 #include "../common/utils.h"
+#include "../common/simd.h"
+#include "../common/ioworker.h"
 #include <iostream>
 #include <iomanip>
 #include <sstream>
+#include <limits>
+#include <algorithm>
 
 int word_align(int numbytes)
 {
@@ -54,19 +58,17 @@ size_t Chunks::UnpackMetaData(const std::vector <uint8_t>&data)
 }
 
 Wav::Wav(bool verbose)
-:chunkpos(0),datapos(0),endofdata(0),byterate(0),blockalign(0),samplesleft(0),verbose(verbose)
+:chunkpos(0),datapos(0),endofdata(0),byterate(0),blockalign(0),samplesleft(0),ioidx(0),verbose(verbose)
 {
-  MD5::Init(&md5ctx);
 };
 
 Wav::Wav(AudioFile &file,bool verbose)
-:AudioFile(file),chunkpos(0),verbose(verbose)
+:AudioFile(file),chunkpos(0),ioidx(0),verbose(verbose)
 {
   kbps=(samplerate*numchannels*bitspersample)/1000;
   int csize=static_cast<int>(ceil(static_cast<double>(bitspersample)/8.));
   byterate=samplerate*numchannels*csize;
   blockalign=numchannels*csize;
-  MD5::Init(&md5ctx);
 };
 
 
@@ -75,95 +77,139 @@ void Wav::InitFileBuf(int maxframesize)
   filebuffer.resize(maxframesize*blockalign);
 }
 
+// samples come straight from the mapped file if there is one, else
+// through the two io buffers. The bytes are hashed on the hash stage
+// while the caller works on the samples
 int Wav::ReadSamples(std::vector <std::vector <int32_t>>&data,int samplestoread)
 {
   // read samples
   if (samplestoread>samplesleft) samplestoread=samplesleft;
-  int bytestoread=samplestoread*blockalign;
-  file.read(reinterpret_cast<char*>(&filebuffer[0]),bytestoread);
-  int bytesread=file.gcount();
-  int samplesread=bytesread/blockalign;
+  const uint8_t *src=nullptr;
+  int samplesread=0;
+  if (fmap.data() && !streamed) {
+    const std::streampos pos=file.tellg();
+    const std::size_t avail=pos<0?0:(fmap.size()-std::min(fmap.size(),static_cast<std::size_t>(pos)))/blockalign;
+    samplesread=static_cast<int>(std::min(static_cast<std::size_t>(samplestoread),avail));
+    src=fmap.data()+static_cast<std::size_t>(pos);
+    file.seekg(pos+static_cast<std::streamoff>(samplesread)*blockalign);
+  } else {
+    // the last hash job still reads the other buffer
+    std::vector <uint8_t> &buf=iobuffer[ioidx];
+    ioidx^=1;
+    int bytestoread=samplestoread*blockalign;
+    if (buf.size()<static_cast<size_t>(bytestoread)) buf.resize(bytestoread);
+    file.read(reinterpret_cast<char*>(buf.data()),bytestoread);
+    int bytesread=file.gcount();
+    samplesread=bytesread/blockalign;
+    src=buf.data();
+  }
 
   samplesleft-=samplesread;
-  if (samplesread!=samplestoread) std::cerr << "warning: read over eof\n";
+  if (samplesread!=samplestoread) {
+    if (numsamples>=0) std::cerr << "warning: read over eof\n";
+    samplesleft=0;
+  }
 
-  MD5::Update(&md5ctx, &filebuffer[0], bytestoread);
+  if (pending_hash.valid()) IOWorker::Shared().Wait(pending_hash);
+  block_hash=hash;
+  HashAsync(src,static_cast<size_t>(samplesread)*blockalign);
 
   const int csize=blockalign/numchannels;
-  // decode samples
-  if (csize==1) {
-    int bufptr=0;
-    for (int i=0;i<samplesread;i++) { // unpack samples
-      for (int k=0;k<numchannels;k++) {
-        uint8_t sample=filebuffer[bufptr];bufptr+=1;
-        data[k][i]=static_cast<int32_t>(sample)-128;
-      }
-    }
-  } else if (csize==2) {
-    int bufptr=0;
-    for (int i=0;i<samplesread;i++) { // unpack samples
-      for (int k=0;k<numchannels;k++) {
-        int16_t sample=((filebuffer[bufptr+1]<<8)|filebuffer[bufptr]);bufptr+=2;
-        data[k][i]=static_cast<int32_t>(sample);
-      }
-    }
-  } else if (csize==3) {
-    int bufptr=0;
-    for (int i=0;i<samplesread;i++) { // unpack samples
-      for (int k=0;k<numchannels;k++) {
-        int32_t sample=0;
-        sample = static_cast<int32_t>(filebuffer[bufptr+2])<<24;
-        sample |= static_cast<int32_t>(filebuffer[bufptr+1])<<16;
-        sample |= static_cast<int32_t>(filebuffer[bufptr])<<8;
-        bufptr+=3;
-        data[k][i]=sample>>8;
-      }
-    }
-  } else std::cerr << "error: unknown csize=" << csize << '\n';
+  if (csize<1 || csize>4) {
+    std::cerr << "error: unknown csize=" << csize << '\n';
+    return samplesread;
+  }
+  // decode samples, 4 bytes: 32 bit int or the bit pattern of a float
+  std::vector <int32_t*> planes(numchannels);
+  for (int k=0;k<numchannels;k++) planes[k]=&data[k][0];
+  SIMD::kernels->deinterleave(src,planes.data(),numchannels,csize,samplesread);
 
   return samplesread;
 }
 
+// seekable inputs only, the hash is up to the caller
+int Wav::SeekSamples(int nsamples)
+{
+  if (streamed || numsamples<0 || nsamples<0 || nsamples>numsamples) return 1;
+  file.clear();
+  file.seekg(datapos+static_cast<std::streamoff>(nsamples)*blockalign);
+  samplesleft=numsamples-nsamples;
+  return file?0:1;
+}
+
 int Wav::WriteSamples(const std::vector <std::vector <int32_t>>&data,int samplestowrite)
 {
   const int csize=blockalign/numchannels;
-  if (csize==1) {
-    int bufptr=0;
-      for (int i=0;i<samplestowrite;i++) { // pack samples
-        for (int k=0;k<numchannels;k++) {
-          filebuffer[bufptr]=static_cast<uint8_t>( (data[k][i]+128) &0xff);
-          bufptr+=1;
-      }
-    }
-  } else if (csize==2) {
-    int bufptr=0;
-      for (int i=0;i<samplestowrite;i++) { // pack samples
-        for (int k=0;k<numchannels;k++) {
-          int16_t sample=data[k][i];
-          filebuffer[bufptr]=sample&0xff;
-          filebuffer[bufptr+1]=(sample>>8)&0xff;
-          bufptr+=2;
-      }
-    }
-  } else if (csize==3) {
-    int bufptr=0;
-      for (int i=0;i<samplestowrite;i++) { // pack samples
-        for (int k=0;k<numchannels;k++) {
-          int32_t sample=data[k][i];
-          filebuffer[bufptr]=sample&0xff;
-          filebuffer[bufptr+1]=(sample>>8)&0xff;
-          filebuffer[bufptr+2]=(sample>>16)&0xff;
-          bufptr+=3;
-      }
-    }
-  }
+  std::vector <const int32_t*> planes(numchannels);
+  for (int k=0;k<numchannels;k++) planes[k]=&data[k][0];
+  SIMD::kernels->interleave(planes.data(),&filebuffer[0],numchannels,csize,samplestowrite);
+
   int bytestowrite=samplestowrite*blockalign;
   file.write(reinterpret_cast<char*>(&filebuffer[0]),bytestowrite);
 
-  MD5::Update(&md5ctx, &filebuffer[0], bytestowrite);
+  // filebuffer is reused right away, hash in place
+  if (pending_hash.valid()) IOWorker::Shared().Wait(pending_hash);
+  hash.Update(&filebuffer[0], bytestowrite);
+  return bytestowrite;
+}
+
+// interleaves into the next io buffer, whose last write and hash are
+// done by now as only one of each is in flight
+std::vector <uint8_t> &Wav::PackSamples(const std::vector <std::vector <int32_t>>&data,int numsamples)
+{
+  const int csize=blockalign/numchannels;
+  const size_t nbytes=static_cast<size_t>(numsamples)*blockalign;
+  std::vector <uint8_t> &buf=iobuffer[ioidx];
+  ioidx^=1;
+  if (buf.size()<nbytes) buf.resize(nbytes);
+
+  std::vector <const int32_t*> planes(numchannels);
+  for (int k=0;k<numchannels;k++) planes[k]=&data[k][0];
+  SIMD::kernels->interleave(planes.data(),buf.data(),numchannels,csize,numsamples);
+  return buf;
+}
+
+int Wav::WriteSamplesAsync(const std::vector <std::vector <int32_t>>&data,int samplestowrite)
+{
+  const int bytestowrite=samplestowrite*blockalign;
+  std::vector <uint8_t> &buf=PackSamples(data,samplestowrite);
+
+  // one write in flight keeps the file in order, the hash of the same
+  // buffer follows it on the io worker
+  Flush();
+  pending_write=IOWorker::Shared().Submit([this,&buf,bytestowrite]{
+    file.write(reinterpret_cast<const char*>(buf.data()),bytestowrite);
+  });
+  HashAsync(buf.data(),bytestowrite);
   return bytestowrite;
 }
 
+int Wav::HashSamples(const std::vector <std::vector <int32_t>>&data,int samplestohash)
+{
+  const int bytestohash=samplestohash*blockalign;
+  HashAsync(PackSamples(data,samplestohash).data(),bytestohash);
+  return bytestohash;
+}
+
+void Wav::Flush()
+{
+  if (pending_write.valid()) IOWorker::Shared().Wait(pending_write);
+}
+
+// hashed on the io worker, one block in flight keeps the hash in order,
+// the block must stay untouched until the next call
+void Wav::HashAsync(const uint8_t *buf,size_t len)
+{
+  if (pending_hash.valid()) IOWorker::Shared().Wait(pending_hash);
+  pending_hash=IOWorker::Shared().Submit([this,buf,len]{hash.Update(buf,len);});
+}
+
+void Wav::FinishHash()
+{
+  if (pending_hash.valid()) IOWorker::Shared().Wait(pending_hash);
+  hash.Finalize();
+}
+
 
 int Wav::ReadHeader()
 {
@@ -227,11 +273,29 @@ int Wav::ReadHeader()
              }
 
           }
+          // 32 bit containers are coded as a whole, whatever the valid bits
+          if (numchannels>0 && blockalign==4*numchannels) bitspersample=32;
           kbps=(samplerate*numchannels*bitspersample)/1000;
-          if (audioformat!=1) {std::cerr << "warning: only PCM Format supported\n";return 1;};
+          if (audioformat==3) { // ieee float
+            if (bitspersample!=32) {std::cerr << "warning: only 32 bit float supported\n";return 1;};
+            floatpcm=true;
+          } else if (audioformat!=1) {std::cerr << "warning: only PCM Format supported\n";return 1;};
         }
       } else if (chunkid==0x61746164) { // 'data' chunk
         myChunks.Append(chunkid,chunksize,NULL,0);
+        if (chunksize==0 || chunksize==0xffffffff || streamed) {
+          // unknown length (or no way to skip it), samples run to eof
+          if (streamed) {
+            numsamples=(chunksize==0 || chunksize==0xffffffff)?-1:chunksize/blockalign;
+          } else {
+            datapos=file.tellg();
+            numsamples=(filesize-datapos)/blockalign;
+            if (chunksize!=0 && chunksize!=0xffffffff) numsamples=std::min(numsamples,static_cast<int>(chunksize/blockalign));
+          }
+          samplesleft=numsamples<0?std::numeric_limits<int>::max():numsamples;
+          seektodatapos=false;
+          break;
+        }
         datapos=file.tellg();
 
         numsamples=chunksize/blockalign;
@@ -271,6 +335,27 @@ int Wav::ReadHeader()
   return 0;
 }
 
+// replace the stored chunks by a canonical RIFF/fmt/data header
+void Wav::InitPCMHeader(int nsamples)
+{
+  numsamples=nsamples;
+  const uint32_t datasize=static_cast<uint32_t>(nsamples)*blockalign;
+
+  uint8_t buf[16];
+  myChunks=Chunks();
+  chunkpos=0;
+  BitUtils::put32LH(buf,0x45564157); // 'WAVE'
+  myChunks.Append(0x46464952,36+word_align(datasize),buf,4);
+  BitUtils::put16LH(buf,floatpcm?3:1);
+  BitUtils::put16LH(buf+2,numchannels);
+  BitUtils::put32LH(buf+4,samplerate);
+  BitUtils::put32LH(buf+8,byterate);
+  BitUtils::put16LH(buf+12,blockalign);
+  BitUtils::put16LH(buf+14,bitspersample);
+  myChunks.Append(0x020746d66,16,buf,16);
+  myChunks.Append(0x61746164,datasize,NULL,0);
+}
+
 int Wav::WriteHeader()
 {
   uint8_t buf[8];
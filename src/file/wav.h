@@ -2,8 +2,9 @@
 #define WAV_H
 
 #include "file.h"
-#include "../common/md5.h"
+#include "../common/hash.h"
 #include <cstdint>
+#include <future>
 
 class Chunks {
   public:
@@ -31,17 +32,32 @@ class Wav : public AudioFile {
     Wav(AudioFile &file,bool verbose=false);
     int ReadHeader();
     int WriteHeader();
+    void InitPCMHeader(int nsamples);
     void InitFileBuf(int maxframesize);
     int ReadSamples(std::vector <std::vector <int32_t>>&data,int samplestoread);
     int WriteSamples(const std::vector <std::vector <int32_t>>&data,int samplestowrite);
+    // double buffered write-behind: interleaves into one buffer while the
+    // previous one is still written, Flush() before any other file access
+    int WriteSamplesAsync(const std::vector <std::vector <int32_t>>&data,int samplestowrite);
+    int HashSamples(const std::vector <std::vector <int32_t>>&data,int samplestohash); // hash only, no file
+    void Flush();
+    void FinishHash(); // waits for the hash stage and finalizes the digest
+    const AudioHash &BlockStartHash() const {return block_hash;}; // hash before the last ReadSamples block
+    int SeekSamples(int nsamples); // continue reading at sample nsamples
     Chunks &GetChunks(){return myChunks;};
-    MD5::MD5Context md5ctx;
+    AudioHash hash;
   private:
+    std::vector <uint8_t> &PackSamples(const std::vector <std::vector <int32_t>>&data,int numsamples);
+    void HashAsync(const uint8_t *buf,size_t len);
     Chunks myChunks;
     size_t chunkpos;
     std::vector <uint8_t>filebuffer;
     std::streampos datapos,endofdata;
     int byterate,blockalign,samplesleft;
+    std::vector <uint8_t>iobuffer[2]; // alternating read/write buffers
+    int ioidx;
+    std::future<void> pending_write,pending_hash;
+    AudioHash block_hash;
     bool verbose;
 };
 #endif // WAV_H
@@ -24,18 +24,6 @@ typedef span<const int32_t> span_ci32;
 typedef span<const double> span_f64;
 
 
-#if defined(__x86_64__) || defined(__i386__)
-    #ifndef __ANDROID__
-        #if (__GNUC__ > 4) || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9)
-        #define USE_AVX256
-    #else
-        #undef USE_AVX256
-    #endif
-#else
-    #undef USE_AVX256
-#endif
-
-//#define USE_AVX512
+// simd kernels are picked at runtime, see common/simd.h
 
 #endif
-#endif
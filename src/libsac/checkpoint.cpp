@@ -0,0 +1,153 @@
+#include "checkpoint.h"
+#include "../common/utils.h"
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <type_traits>
+
+static_assert(std::is_trivially_copyable<AudioHash>::value,"hash state is stored raw");
+
+static const uint32_t ckpt_magic=0x4b434153; // 'SACK'
+static const uint32_t ckpt_version=1;
+
+static void put64LH(std::vector<uint8_t> &buf,uint64_t val)
+{
+  uint8_t b[8];
+  BitUtils::put32LH(b,static_cast<uint32_t>(val));
+  BitUtils::put32LH(b+4,static_cast<uint32_t>(val>>32));
+  buf.insert(buf.end(),b,b+8);
+}
+
+static void put32LH(std::vector<uint8_t> &buf,uint32_t val)
+{
+  uint8_t b[4];
+  BitUtils::put32LH(b,val);
+  buf.insert(buf.end(),b,b+4);
+}
+
+static void putfloat(std::vector<uint8_t> &buf,float val)
+{
+  uint32_t u;
+  std::memcpy(&u,&val,4);
+  put32LH(buf,u);
+}
+
+// bounds checked reads, a short file sets ok=false
+struct tckpt_reader {
+  const std::vector<uint8_t> &buf;
+  std::size_t pos=0;
+  bool ok=true;
+  explicit tckpt_reader(const std::vector<uint8_t> &buf):buf(buf){};
+  const uint8_t *take(std::size_t n)
+  {
+    if (!ok || buf.size()-pos<n) {ok=false;return nullptr;}
+    const uint8_t *p=&buf[pos];
+    pos+=n;
+    return p;
+  }
+  uint32_t get32() {const uint8_t *p=take(4);return p?BitUtils::get32LH(p):0;};
+  uint64_t get64() {const uint64_t lo=get32();return lo|(static_cast<uint64_t>(get32())<<32);};
+  float getfloat() {const uint32_t u=get32();float x;std::memcpy(&x,&u,4);return x;};
+};
+
+int Checkpoint::Save(const std::string &fname) const
+{
+  std::vector<uint8_t> buf;
+  put32LH(buf,ckpt_magic);
+  put32LH(buf,ckpt_version);
+  put32LH(buf,numchannels);
+  put32LH(buf,samplerate);
+  put32LH(buf,bitspersample);
+  put32LH(buf,numsamples);
+  put32LH(buf,max_framelen);
+  put32LH(buf,flags);
+  put64LH(buf,static_cast<uint64_t>(samplescoded));
+  put64LH(buf,sacpos);
+  put64LH(buf,hdrpos);
+
+  put32LH(buf,sizeof(AudioHash));
+  const uint8_t *hp=reinterpret_cast<const uint8_t*>(&hash);
+  buf.insert(buf.end(),hp,hp+sizeof(AudioHash));
+
+  put32LH(buf,profile.coefs.size());
+  for (const auto &c:profile.coefs) {
+    putfloat(buf,c.vmin);
+    putfloat(buf,c.vmax);
+    putfloat(buf,c.vdef);
+  }
+
+  put32LH(buf,seektable.size());
+  for (const auto &entry:seektable) {
+    put64LH(buf,entry.pos);
+    put32LH(buf,entry.start);
+    put32LH(buf,entry.numsamples);
+  }
+
+  // the last good checkpoint is only replaced by a completely written one
+  const std::string tmpname=fname+".tmp";
+  std::error_code ec;
+  std::ofstream f(tmpname,std::ios_base::binary|std::ios_base::trunc);
+  f.write(reinterpret_cast<const char*>(buf.data()),buf.size());
+  f.close();
+  if (!f) {
+    std::filesystem::remove(tmpname,ec);
+    return 1;
+  }
+  std::filesystem::rename(tmpname,fname,ec);
+  if (ec) {
+    std::filesystem::remove(tmpname,ec);
+    return 1;
+  }
+  return 0;
+}
+
+int Checkpoint::Load(const std::string &fname)
+{
+  std::ifstream f(fname,std::ios_base::binary);
+  if (!f) return 1;
+  const std::vector<uint8_t> buf((std::istreambuf_iterator<char>(f)),std::istreambuf_iterator<char>());
+
+  tckpt_reader rd(buf);
+  if (rd.get32()!=ckpt_magic || rd.get32()!=ckpt_version) return 1;
+  numchannels=rd.get32();
+  samplerate=rd.get32();
+  bitspersample=rd.get32();
+  numsamples=rd.get32();
+  max_framelen=rd.get32();
+  flags=rd.get32();
+  samplescoded=static_cast<int64_t>(rd.get64());
+  sacpos=rd.get64();
+  hdrpos=rd.get64();
+
+  if (rd.get32()!=sizeof(AudioHash)) return 1;
+  const uint8_t *hp=rd.take(sizeof(AudioHash));
+  if (hp) std::memcpy(reinterpret_cast<uint8_t*>(&hash),hp,sizeof(AudioHash));
+
+  const uint32_t ncoefs=rd.get32();
+  if (!rd.ok || ncoefs>(buf.size()-rd.pos)/12) return 1;
+  profile.Init(ncoefs);
+  for (auto &c:profile.coefs) {
+    c.vmin=rd.getfloat();
+    c.vmax=rd.getfloat();
+    c.vdef=rd.getfloat();
+  }
+
+  const uint32_t nentries=rd.get32();
+  if (!rd.ok || nentries>(buf.size()-rd.pos)/16) return 1;
+  seektable.resize(nentries);
+  for (auto &entry:seektable) {
+    entry.pos=rd.get64();
+    entry.start=rd.get32();
+    entry.numsamples=rd.get32();
+  }
+  return rd.ok?0:1;
+}
+
+bool Checkpoint::Matches(const AudioFile &wav) const
+{
+  return numchannels==static_cast<uint32_t>(wav.getNumChannels())
+      && samplerate==static_cast<uint32_t>(wav.getSampleRate())
+      && bitspersample==static_cast<uint32_t>(wav.getBitsPerSample())
+      && numsamples==static_cast<uint32_t>(wav.getNumSamples())
+      && samplescoded>=0 && samplescoded<=wav.getNumSamples();
+}
@@ -0,0 +1,32 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include "../file/sac.h"
+#include "../common/hash.h"
+#include "profile.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// encoder state at a frame boundary, kept in a sidecar next to the
+// output: frames before samplescoded are complete in the first sacpos
+// bytes of the .sac, hash covers the pcm up to there. Same binary only,
+// the hash context is stored as is
+class Checkpoint {
+  public:
+    Checkpoint(){};
+    static std::string SidecarName(const std::string &sacfile) {return sacfile+".ckpt";};
+    int Save(const std::string &fname) const; // atomic: temp file + rename
+    int Load(const std::string &fname);
+    bool Matches(const AudioFile &wav) const; // same input format and length
+
+    uint32_t numchannels=0,samplerate=0,bitspersample=0,numsamples=0;
+    uint8_t max_framelen=0,flags=0;
+    int64_t samplescoded=0;
+    uint64_t sacpos=0,hdrpos=0;
+    AudioHash hash;
+    SacProfile profile; // optimizer start point of the next frame
+    std::vector <Sac::tseek_entry> seektable;
+};
+
+#endif // CHECKPOINT_H
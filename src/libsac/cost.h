@@ -21,10 +21,7 @@ class CostL1 : public CostFunction {
 public:
     double Calc(span_ci32 buf) const override {
         if (buf.size() > 0) {
-            int64_t sum = 0;
-            for (auto it = buf.begin(); it != buf.end(); ++it) {
-                sum += std::fabs(*it);
-            }
+            const int64_t sum = SIMD::kernels->sum_abs(buf.data(), buf.size());
             return sum / static_cast<double>(buf.size());
         } else {
             return 0.0;
@@ -37,10 +34,7 @@ class CostRMS : public CostFunction {
 public:
     double Calc(span_ci32 buf) const override {
         if (buf.size() > 0) {
-            int64_t sum = 0;
-            for (auto it = buf.begin(); it != buf.end(); ++it) {
-                sum += (*it) * (*it);
-            }
+            const int64_t sum = SIMD::kernels->sum_sq(buf.data(), buf.size());
             return std::sqrt(sum / static_cast<double>(buf.size()));
         } else {
             return 0.0;
@@ -86,12 +80,8 @@ class CostEntropy : public CostFunction {
     {
       double entropy=0.0;
       if (buf.size()) {
-        int32_t minval = std::numeric_limits<int32_t>::max();
-        int32_t maxval = std::numeric_limits<int32_t>::min();
-        for (auto it = buf.begin(); it != buf.end(); ++it) {
-          if (*it > maxval) maxval = *it;
-          if (*it < minval) minval = *it;
-        }
+        int32_t minval,maxval;
+        SIMD::kernels->minmax(buf.data(),buf.size(),minval,maxval);
         const auto vmap=[&](int32_t val) {return val-minval;};
 
         std::vector<int> counts(maxval-minval+1,0);
@@ -109,31 +99,31 @@ class CostEntropy : public CostFunction {
     }
 };
 
-/*class StaticBitModel {
+// -log2(i/PSCALE) in bits
+static struct tlog2_tbl
+{
+  tlog2_tbl()
+  {
+    tbl[0]=PBITS;
+    for (int i=1;i<PSCALE;i++)
+      tbl[i]=-std::log2(static_cast<double>(i)/static_cast<double>(PSCALE));
+  }
+  double operator[](int i) const {return tbl[i];};
+  double tbl[PSCALE];
+} log2_tbl;
+
+// bit sink for the templated coders, counts the ideal code length
+// instead of producing bytes
+class StaticBitModel {
   public:
-    StaticBitModel()
-    :pr(2,vec1D(PSCALE))
-    {
-      for (std::size_t i=1;i<PSCALE;i++)
-      {
-        double p1 = static_cast<double>(i)/static_cast<double>(PSCALE);
-        double t0 = -std::log2(1.0-p1);
-        double t1 = -std::log2(p1);
-        pr[0][i]= t0;
-        pr[1][i]= t1;
-      }
-      ResetCount();
-    }
+    StaticBitModel(){ResetCount();};
     void ResetCount(){nbits=0;};
-    void EncodeBitOne(uint32_t p1,int bit)
+    inline void EncodeBitOne(uint32_t p1,int bit)
     {
-      nbits += pr[bit][p1];
+      nbits += log2_tbl[bit?p1:PSCALE-p1];
     }
-    auto EncodeP1_Func() {return [&](uint32_t p1,int bit) {return EncodeBitOne(p1,bit);};}; // stupid C++
-
   double nbits;
-  vec2D pr;
-};*/
+};
 
 class CostBitplane : public CostFunction {
  public:
@@ -141,30 +131,23 @@ class CostBitplane : public CostFunction {
   }
   double Calc(span_ci32 buf) const override
   {
+    // Calc runs concurrently from the pool, every thread keeps its own
+    // coder and buffer and resets them per call
+    thread_local std::vector<int32_t> ubuf;
+    thread_local BitplaneCoder bc(0,0);
+
     int numsamples=buf.size();
-    std::vector<int32_t> ubuf(numsamples);
+    ubuf.resize(numsamples);
     int vmax=0;
     for (int i=0;i<numsamples;i++) {
        int val=MathUtils::S2U(buf[i]);
        if (val>vmax) vmax=val;
        ubuf[i]=val;
     }
-    #if 1
-    BufIO iobuf;
-    RangeCoderSH rc(iobuf);
-    rc.Init();
-    BitplaneCoder bc_rc(MathUtils::iLog2(vmax),numsamples);
-    bc_rc.Encode(rc.encode_p1,&ubuf[0]);
-    rc.Stop();
-    double c0=iobuf.GetBufPos();
-    #else
-
+    bc.Reset(MathUtils::iLog2(vmax),numsamples);
     StaticBitModel bm;
-    BitplaneCoder bc_bit(MathUtils::iLog2(vmax),numsamples);
-    bc_bit.Encode(bm.EncodeP1_Func(),&ubuf[0]);
-
+    bc.Encode(bm,ubuf.data());
     double c0=bm.nbits/8.0;
-    #endif
     return c0;
   }
 };
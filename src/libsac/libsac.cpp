@@ -1,22 +1,88 @@
 #include <algorithm>
-#include <thread>
+#include <array>
 #include <future>
+#include <deque>
+#include <filesystem>
+#include <memory>
 #include <vector>
 #include <iomanip>
 
 #include "libsac.h"
 #include "pred.h"
 #include "sparse.h"
+#include "pcm32.h"
+#include "checkpoint.h"
 #include "../common/timer.h"
+#include "../common/ioworker.h"
 #include <cstring>
 #include "../opt/dds.h"
 #include "span.h"
 #include "../opt/de.h"
 
+void FrameCoder::coder_ctx::SetPreset(int level)
+{
+  switch (level) {
+    case 0:
+      optimize=0;
+      break;
+    case 1:
+      optimize=1;
+      ocfg.fraction=0.075;
+      ocfg.maxnfunc=100;
+      ocfg.sigma=0.2;
+      ocfg.dds_cfg.c_fail_max=30;
+      break;
+    case 2:
+      optimize=1;
+      ocfg.fraction=0.2;
+      ocfg.maxnfunc=250;
+      ocfg.sigma=0.2;
+      break;
+    case 3:
+      optimize=1;
+      ocfg.fraction=0.25;
+      ocfg.maxnfunc=500;
+      ocfg.sigma=0.2;
+      break;
+    case 4:
+      optimize=1;
+      ocfg.fraction=0.50;
+      ocfg.maxnfunc=1000;
+      ocfg.optk=2;
+      ocfg.sigma=0.20;
+      ocfg.optimize_cost=SearchCost::Bitplane;
+      break;
+    case 5:
+      optimize=1;
+      ocfg.fraction=0.75;
+      ocfg.maxnfunc=1500;
+      ocfg.optk=2;
+      ocfg.sigma=0.25;
+      ocfg.optimize_cost=SearchCost::Bitplane;
+      break;
+    default:break;
+  }
+}
+
+void FrameCoder::coder_ctx::ConfigureOpt()
+{
+  if (ocfg.optimize_search==SearchMethod::DDS)
+  {
+    ocfg.dds_cfg.nfunc_max=ocfg.maxnfunc;
+    ocfg.dds_cfg.num_threads=ocfg.num_threads;
+    ocfg.dds_cfg.sigma_init=ocfg.sigma;
+  } else if (ocfg.optimize_search==SearchMethod::DE)
+  {
+    ocfg.de_cfg.nfunc_max=ocfg.maxnfunc;
+    ocfg.de_cfg.num_threads=ocfg.num_threads;
+    ocfg.de_cfg.sigma_init=ocfg.sigma;
+  }
+}
+
 FrameCoder::FrameCoder(int numchannels,int framesize,const coder_ctx &opt)
-:numchannels_(numchannels),framesize_(framesize),opt(opt)
+:numchannels_(numchannels),framesize_(framesize),kernels_(SIMD::kernels),opt(opt)
 {
-  profile_size_bytes_=base_profile.LoadBaseProfile()*4;
+  profile_size_bytes_=base_profile.LoadBaseProfile(opt.ols_solver)*4;
 
   framestats.resize(numchannels);
   samples.resize(numchannels);
@@ -34,7 +100,30 @@ FrameCoder::FrameCoder(int numchannels,int framesize,const coder_ctx &opt)
   encoded.resize(numchannels);
   enc_temp1.resize(numchannels);
   enc_temp2.resize(numchannels);
+  enc_res.resize(numchannels);
+  bpcoder.reserve(numchannels);
+  bpcoder_map.reserve(numchannels);
+  for (int i=0;i<numchannels;i++) {
+    bpcoder.emplace_back(0,0);
+    bpcoder_map.emplace_back(0,0);
+  }
   numsamples_=0;
+  sample_fmt_=PCM;
+  frame_crc_=false;
+  crc_ok_=true;
+}
+
+FrameCoder::SampleFormat FrameCoder::GetSampleFormat(const AudioFile &file)
+{
+  if (file.getBitsPerSample()<=24) return PCM;
+  return file.isFloat()?FLOAT32:PCM32;
+}
+
+void FrameCoder::SetSampleFormat(SampleFormat fmt)
+{
+  sample_fmt_=fmt;
+  // the sparse pcm map covers 16 bit values only
+  if (fmt!=PCM) opt.sparse_pcm=0;
 }
 
 
@@ -43,6 +132,7 @@ void FrameCoder::SetParam(Predictor::tparam &param,const SacProfile &profile,boo
 {
   if (optimize) param.k=opt.ocfg.optk;
   else param.k=1;
+  param.kernels=kernels_;
 
   param.lambda0=param.lambda1=profile.Get(0);
   param.ols_nu0=param.ols_nu1=profile.Get(1);
@@ -69,6 +159,7 @@ void FrameCoder::SetParam(Predictor::tparam &param,const SacProfile &profile,boo
   param.nS0=round(profile.Get(26));
   param.nS1=round(profile.Get(27));
   param.nM0=round(profile.Get(9));
+  param.ols_solver=round(profile.Get(41));
 
   param.beta_sum0=profile.Get(34);
   param.beta_pow0=profile.Get(35);
@@ -95,100 +186,197 @@ void FrameCoder::SetParam(Predictor::tparam &param,const SacProfile &profile,boo
   };// else if (param.nS1==0) param.nS1=1;
 }
 
+// channel graph: channels are coded in units of a stereo pair (2k,2k+1),
+// with an odd last channel coded on its own. Inside a pair the reference
+// channel ch_ref is predicted first and the other one sees its past and
+// nS1 future samples. Units do not depend on each other
+void FrameCoder::GetChannelUnits(std::vector<std::pair<int,int>> &units) const
+{
+  units.clear();
+  for (int ch=0;ch<numchannels_;ch+=2) {
+    if (ch+1<numchannels_) units.emplace_back(ch,ch+1);
+    else units.emplace_back(ch,-1);
+  }
+}
+
+void FrameCoder::ForEachUnit(const std::function<void(int ch0,int ch1)> &func)
+{
+  std::vector<std::pair<int,int>> units;
+  GetChannelUnits(units);
+  const int nunits=units.size();
+  if (opt.mt_mode && nunits>1)
+    ThreadPool::Shared().ParallelFor(nunits,[&](int u){func(units[u].first,units[u].second);});
+  else
+    for (const auto &unit:units) func(unit.first,unit.second);
+}
+
+// position of ch1 while ch0 codes idx0 in the interleaved stereo loop
+int FrameCoder::StereoLag(const Predictor::tparam &param,int idx0)
+{
+  return std::max(0,idx0-std::max(0,param.nS1-1));
+}
+
 void FrameCoder::PredictFrame(const SacProfile &profile,tch_samples &error,int from,int numsamples,bool optimize)
 {
 
   Predictor::tparam param;
   SetParam(param,profile,optimize);
-  Predictor pr(param);
-
-  auto eprocess=[&](int ch_p,int ch,int32_t val,int idx) {
-      double pd=pr.predict(ch_p);
-      int32_t pi=std::clamp((int32_t)std::round(pd),framestats[ch].minval,framestats[ch].maxval);
-      if (!optimize) pred[ch][idx]=pi+framestats[ch].mean;
-      error[ch][idx]=val-pi;
-      pr.update(ch_p,val);
-  };
 
+  ForEachUnit([&](int ch_a,int ch_b) {
+    Predictor pr(param);
 
-  if (numchannels_==1) {
-    const auto *src=&samples[0][from];
-    for (int idx=0;idx<numsamples;idx++)
-    {
-      pr.fillbuf_ch0(src,idx,src,idx);
-      eprocess(0,0,src[idx],idx);
-    }
-  } else if (numchannels_==2) {
-    int ch0=param.ch_ref;
-    int ch1=1-ch0;
-
-    const auto *src0=&samples[ch0][from];
-    const auto *src1=&samples[ch1][from];
+    auto eprocess=[&](int ch_p,int ch,int32_t val,int idx) {
+        double pd=pr.predict(ch_p);
+        int32_t pi=std::clamp((int32_t)std::round(pd),framestats[ch].minval,framestats[ch].maxval);
+        if (!optimize) pred[ch][idx]=pi+framestats[ch].mean;
+        error[ch][idx]=val-pi;
+        pr.update(ch_p,val);
+    };
 
-    int idx0=0,idx1=0;
-    while (idx0<numsamples || idx1<numsamples)
-    {
-      if (idx0<numsamples) {
-        pr.fillbuf_ch0(src0,idx0,src1,idx1);
-        eprocess(0,ch0,src0[idx0],idx0);
-        idx0++;
+    if (ch_b<0) {
+      const auto *src=&samples[ch_a][from];
+      for (int idx=0;idx<numsamples;idx++)
+      {
+        pr.fillbuf_ch0(src,idx,src,idx);
+        eprocess(0,ch_a,src[idx],idx);
       }
-      if (idx0>=param.nS1) {
-        pr.fillbuf_ch1(src0,src1,idx1,numsamples);
-        eprocess(1,ch1,src1[idx1],idx1);
-        idx1++;
+    } else {
+      int ch0=param.ch_ref?ch_b:ch_a;
+      int ch1=param.ch_ref?ch_a:ch_b;
+
+      const auto *src0=&samples[ch0][from];
+      const auto *src1=&samples[ch1][from];
+
+      if (opt.mt_mode>2 && !optimize) {
+        // all input is known, both channels run at once. ch0 sees ch1
+        // up to the same position as in the interleaved order below
+        ThreadPool::Shared().ParallelFor(2,[&](int i) {
+          if (i==0) {
+            for (int idx0=0;idx0<numsamples;idx0++) {
+              pr.fillbuf_ch0(src0,idx0,src1,StereoLag(param,idx0));
+              eprocess(0,ch0,src0[idx0],idx0);
+            }
+          } else {
+            for (int idx1=0;idx1<numsamples;idx1++) {
+              pr.fillbuf_ch1(src0,src1,idx1,numsamples);
+              eprocess(1,ch1,src1[idx1],idx1);
+            }
+          }
+        });
+      } else {
+        int idx0=0,idx1=0;
+        while (idx0<numsamples || idx1<numsamples)
+        {
+          if (idx0<numsamples) {
+            pr.fillbuf_ch0(src0,idx0,src1,idx1);
+            eprocess(0,ch0,src0[idx0],idx0);
+            idx0++;
+          }
+          if (idx0>=param.nS1) {
+            pr.fillbuf_ch1(src0,src1,idx1,numsamples);
+            eprocess(1,ch1,src1[idx1],idx1);
+            idx1++;
+          }
+        }
       }
     }
-  }
+  });
 }
 
 void FrameCoder::UnpredictFrame(const SacProfile &profile,int numsamples)
 {
   Predictor::tparam param;
   SetParam(param,profile,false);
-  Predictor pr(param);
 
-  auto dprocess=[&](int ch_p,int ch,int32_t *dst,int idx) {
-    const double pd=pr.predict(ch_p);
-    const int32_t pi=std::clamp((int32_t)round(pd),framestats[ch].minval,framestats[ch].maxval);
+  ForEachUnit([&](int ch_a,int ch_b) {
+    Predictor pr(param);
 
+    auto dpredict=[&](int ch_p,int ch,int32_t *dst,int idx) {
+      const double pd=pr.predict(ch_p);
+      const int32_t pi=std::clamp((int32_t)round(pd),framestats[ch].minval,framestats[ch].maxval);
 
-    if (framestats[ch].enc_mapped)
-      dst[idx]=pi+framestats[ch].mymap.Unmap(pi+framestats[ch].mean,error[ch][idx]);
-    else
-      dst[idx]=pi+error[ch][idx];
 
-    pr.update(ch_p,dst[idx]);
-  };
+      if (framestats[ch].enc_mapped)
+        dst[idx]=pi+framestats[ch].mymap.Unmap(pi+framestats[ch].mean,error[ch][idx]);
+      else
+        dst[idx]=pi+error[ch][idx];
+    };
+    auto dprocess=[&](int ch_p,int ch,int32_t *dst,int idx) {
+      dpredict(ch_p,ch,dst,idx);
+      pr.update(ch_p,dst[idx]);
+    };
 
-  if (numchannels_==1) {
-    auto *dst=&samples[0][0];
-    for (int idx=0;idx<numsamples;idx++)
-    {
-      pr.fillbuf_ch0(dst,idx,dst,idx);
-      dprocess(0,0,dst,idx);
-    }
-  } else if (numchannels_==2) {
-    int ch0=param.ch_ref;
-    int ch1=1-ch0;
-
-    auto *dst0=&samples[ch0][0];
-    auto *dst1=&samples[ch1][0];
-    int idx0=0,idx1=0;
-    while (idx0<numsamples || idx1<numsamples)
-    {
-      if (idx0<numsamples) {
-        pr.fillbuf_ch0(dst0,idx0,dst1,idx1);
-        dprocess(0,ch0,dst0,idx0);
-        idx0++;
+    if (ch_b<0) {
+      auto *dst=&samples[ch_a][0];
+      for (int idx=0;idx<numsamples;idx++)
+      {
+        pr.fillbuf_ch0(dst,idx,dst,idx);
+        dprocess(0,ch_a,dst,idx);
       }
-      if (idx0>=param.nS1) {
-        pr.fillbuf_ch1(dst0,dst1,idx1,numsamples);
-        dprocess(1,ch1,dst1,idx1);
-        idx1++;
+    } else {
+      int ch0=param.ch_ref?ch_b:ch_a;
+      int ch1=param.ch_ref?ch_a:ch_b;
+
+      auto *dst0=&samples[ch0][0];
+      auto *dst1=&samples[ch1][0];
+      if (opt.mt_mode>2 && ThreadPool::Shared().NumThreads()>1) {
+        // ch1 runs as a pool task, each side publishes how many samples it
+        // has decoded and updates its model after that, off the other's
+        // critical path. If ch0 has to wait while the task is still queued
+        // it claims ch1 and runs it here in the serial order instead
+        ThreadPool &pool=ThreadPool::Shared();
+        std::atomic<int> done0(0),done1(0);
+        std::atomic<bool> claimed(false);
+        auto wait_for=[](const std::atomic<int> &done,int n) {
+          for (int spin=0;done.load(std::memory_order_acquire)<n;spin++)
+            if (spin>=64) std::this_thread::yield();
+        };
+        int idx1=0; // owned by whoever claimed ch1
+        auto step1=[&] {
+          wait_for(done0,std::min(idx1+param.nS1,numsamples));
+          pr.fillbuf_ch1(dst0,dst1,idx1,numsamples);
+          dpredict(1,ch1,dst1,idx1);
+          done1.store(idx1+1,std::memory_order_release);
+          pr.update(1,dst1[idx1]);
+          idx1++;
+        };
+        auto task1=pool.Submit([&] {
+          if (!claimed.exchange(true)) while (idx1<numsamples) step1();
+        });
+        bool inline1=false;
+        for (int idx0=0;idx0<numsamples;idx0++) {
+          const int lag=StereoLag(param,idx0);
+          if (param.nM0>0 && done1.load(std::memory_order_acquire)<lag) {
+            if (!inline1) inline1=!claimed.exchange(true);
+            if (inline1) while (idx1<lag) step1(); // ch0 is far enough ahead
+            else wait_for(done1,lag);
+          }
+          pr.fillbuf_ch0(dst0,idx0,dst1,lag);
+          dpredict(0,ch0,dst0,idx0);
+          done0.store(idx0+1,std::memory_order_release);
+          pr.update(0,dst0[idx0]);
+        }
+        if (!inline1) inline1=!claimed.exchange(true);
+        if (inline1) while (idx1<numsamples) step1();
+        pool.Wait(task1);
+      } else {
+        int idx0=0,idx1=0;
+        while (idx0<numsamples || idx1<numsamples)
+        {
+          if (idx0<numsamples) {
+            pr.fillbuf_ch0(dst0,idx0,dst1,idx1);
+            dprocess(0,ch0,dst0,idx0);
+            idx0++;
+          }
+          if (idx0>=param.nS1) {
+            pr.fillbuf_ch1(dst0,dst1,idx1,numsamples);
+            dprocess(1,ch1,dst1,idx1);
+            idx1++;
+          }
+        }
       }
     }
-  }
+  });
 
   // add mean
   for (int ch=0;ch<numchannels_;ch++) {
@@ -197,31 +385,39 @@ void FrameCoder::UnpredictFrame(const SacProfile &profile,int numsamples)
   }
 }
 
-int FrameCoder::EncodeMonoFrame_Normal(int ch,int numsamples,BufIO &buf)
+// abort check for the concurrent sparse trials
+static auto SizeAbove(const BufIO &buf,const std::atomic<std::size_t> *limit)
+{
+  return [&buf,limit]{return limit && buf.GetBufPos()>limit->load(std::memory_order_relaxed);};
+}
+
+int FrameCoder::EncodeMonoFrame_Normal(int ch,int numsamples,BufIO &buf,const std::atomic<std::size_t> *limit)
 {
   buf.Reset();
   RangeCoderSH rc(buf);
   rc.Init();
 
-  BitplaneCoder bc(framestats[ch].maxbpn,numsamples);
+  BitplaneCoder &bc=bpcoder[ch];
+  bc.Reset(framestats[ch].maxbpn,numsamples);
   int32_t *psrc=&(s2u_error[ch][0]);
-  bc.Encode(rc.encode_p1,psrc);
+  if (!bc.Encode(rc,psrc,SizeAbove(buf,limit))) return -1;
   rc.Stop();
   return buf.GetBufPos();
 }
 
-int FrameCoder::EncodeMonoFrame_Mapped(int ch,int numsamples,BufIO &buf)
+int FrameCoder::EncodeMonoFrame_Mapped(int ch,int numsamples,BufIO &buf,const std::atomic<std::size_t> *limit)
 {
   buf.Reset();
 
   RangeCoderSH rc(buf);
   rc.Init();
 
-  BitplaneCoder bc(framestats[ch].maxbpn_map,numsamples);
+  BitplaneCoder &bc=bpcoder_map[ch];
+  bc.Reset(framestats[ch].maxbpn_map,numsamples);
 
-  MapEncoder me(rc,framestats[ch].mymap.usedl,framestats[ch].mymap.usedh);
-  me.Encode();
-  bc.Encode(rc.encode_p1,&(s2u_error_map[ch][0]));
+  MapEncoder me(framestats[ch].mymap.usedl,framestats[ch].mymap.usedh);
+  me.Encode(rc);
+  if (!bc.Encode(rc,&(s2u_error_map[ch][0]),SizeAbove(buf,limit))) return -1;
   rc.Stop();
   return buf.GetBufPos();
 }
@@ -241,7 +437,8 @@ double FrameCoder::CalcRemapError(int ch, int numsamples)
 
     CostL1 cost;
 
-    double ent1 = cost.Calc(span_ci32{emap.data(), static_cast<unsigned>(numsamples)});
+    // cost of the plain over the mapped error, >1 if the map helps
+    double ent1 = cost.Calc(span_ci32{&error[ch][0], static_cast<unsigned>(numsamples)});
     double ent2 = cost.Calc(span_ci32{&emap[0],static_cast<unsigned>(numsamples)});
     double r=1.0;
     if (ent2!=0.0) r=ent1/ent2;
@@ -257,23 +454,51 @@ void FrameCoder::EncodeMonoFrame(int ch,int numsamples)
     encoded[ch]=enc_temp1[ch];
   } else {
     double r = CalcRemapError(ch,numsamples);
-    int size_normal=EncodeMonoFrame_Normal(ch,numsamples,enc_temp1[ch]);
     framestats[ch].enc_mapped=false;
-    encoded[ch]=enc_temp1[ch];
 
     if (r > 1.05)
     {
-      int size_mapped=EncodeMonoFrame_Mapped(ch,numsamples,enc_temp2[ch]);
-      if (size_mapped<size_normal)
+      // both trials at once, the first to finish publishes its size and
+      // the other one stops as soon as it can no longer be smaller
+      std::atomic<std::size_t> limit(std::numeric_limits<std::size_t>::max());
+      auto publish=[&limit](int size) {
+        std::size_t cur=limit.load();
+        while (size>=0 && std::size_t(size)<cur && !limit.compare_exchange_weak(cur,size));
+      };
+      int size_normal=-1,size_mapped=-1;
+      ThreadPool::Shared().ParallelFor(2,[&](int i) {
+        if (i==0) publish(size_normal=EncodeMonoFrame_Normal(ch,numsamples,enc_temp1[ch],&limit));
+        else publish(size_mapped=EncodeMonoFrame_Mapped(ch,numsamples,enc_temp2[ch],&limit));
+      });
+      if (size_mapped>=0 && (size_normal<0 || size_mapped<size_normal))
       {
         if (opt.verbose_level>0) {
-          std::cout << "  sparse frame " << size_normal << " -> " << size_mapped << " (" << (size_mapped-size_normal) << ")\n";
+          if (size_normal<0) std::cout << "  sparse frame -> " << size_mapped << " (normal stopped)\n";
+          else std::cout << "  sparse frame " << size_normal << " -> " << size_mapped << " (" << (size_mapped-size_normal) << ")\n";
         }
         framestats[ch].enc_mapped=true;
         encoded[ch]=enc_temp2[ch];
-      }
+      } else encoded[ch]=enc_temp1[ch];
+    } else {
+      EncodeMonoFrame_Normal(ch,numsamples,enc_temp1[ch]);
+      encoded[ch]=enc_temp1[ch];
     }
   }
+  if (sample_fmt_!=PCM) AppendResidual(ch);
+}
+
+// 32 bit formats: [size of the bitplane stream][bitplane stream][residual stream]
+void FrameCoder::AppendResidual(int ch)
+{
+  BufIO block(4+encoded[ch].GetBufPos()+enc_res[ch].GetBufPos());
+  uint8_t buf[4];
+  BitUtils::put32LH(buf,encoded[ch].GetBufPos());
+  for (int i=0;i<4;i++) block.PutByte(buf[i]);
+  for (const BufIO *src:{&encoded[ch],&enc_res[ch]}) {
+    const std::vector<uint8_t> &data=src->GetBuf();
+    for (std::size_t i=0;i<src->GetBufPos();i++) block.PutByte(data[i]);
+  }
+  encoded[ch]=std::move(block);
 }
 
 void FrameCoder::DecodeMonoFrame(int ch,int numsamples)
@@ -281,18 +506,20 @@ void FrameCoder::DecodeMonoFrame(int ch,int numsamples)
   int32_t *dst=&(error[ch][0]);
   BufIO &buf=encoded[ch];
   buf.Reset();
+  if (sample_fmt_!=PCM) buf.SetBufPos(4); // skip the bitplane stream size
 
   RangeCoderSH rc(buf,1);
   rc.Init();
   if (framestats[ch].enc_mapped) {
     framestats[ch].mymap.Reset();
-    MapEncoder me(rc,framestats[ch].mymap.usedl,framestats[ch].mymap.usedh);
-    me.Decode();
+    MapEncoder me(framestats[ch].mymap.usedl,framestats[ch].mymap.usedh);
+    me.Decode(rc);
     //std::cout << buf.GetBufPos() << std::endl;
   }
 
-  BitplaneCoder bc(framestats[ch].maxbpn,numsamples);
-  bc.Decode(rc.decode_p1,dst);
+  BitplaneCoder &bc=bpcoder[ch];
+  bc.Reset(framestats[ch].maxbpn,numsamples);
+  bc.Decode(rc,dst);
   rc.Stop();
 }
 
@@ -306,6 +533,7 @@ void FrameCoder::PrintProfile(SacProfile &profile)
     std::cout << "lpc (nA " << std::round(profile.Get(24)) << " nM0 " << std::round(profile.Get(9));
     std::cout << ") (nB " << std::round(profile.Get(25)) << " nS0 " << std::round(profile.Get(26)) << " nS1 " << std::round(profile.Get(27)) << ")\n";
     std::cout << "lpc nu " << param.ols_nu0 << ' ' << param.ols_nu1 << '\n';
+    std::cout << "lpc solver " << (param.ols_solver==OLS::UPDATE?"update":"cholesky") << '\n';
     std::cout << "lpc cov0 " << param.beta_sum0 << ' ' << param.beta_pow0 << ' ' << param.beta_add0 << "\n";
     std::cout << "lms0 ";
     for (int i=28;i<=30;i++) std::cout << round(profile.Get(i)) << ' ';
@@ -343,12 +571,11 @@ double FrameCoder::GetCost(const CostFunction *func,const tch_samples &samples,s
   double cost=0.0;
   if (opt.mt_mode>1 && numchannels_>1) {
 
-    std::vector <std::future<double>> threads;
-    for (int ch=0;ch<numchannels_;ch++)
-        threads.emplace_back(std::async([=]{return func->Calc(span_ci32(span_ch(ch).data(), span_ch(ch).size()));}));
+    std::vector <double> ch_cost(numchannels_);
+    ThreadPool::Shared().ParallelFor(numchannels_,[&](int ch){ch_cost[ch]=func->Calc(span_ci32(span_ch(ch).data(), span_ch(ch).size()));});
 
-    for (auto &thread : threads)
-      cost += thread.get();
+    for (auto c : ch_cost)
+      cost += c;
 
   } else {
     for (int ch=0;ch<numchannels_;ch++) {
@@ -433,8 +660,36 @@ void FrameCoder::CnvError_S2U(tch_samples &error,int numsamples)
   }
 }
 
+void FrameCoder::SplitSamples()
+{
+  const auto fmt=sample_fmt_==FLOAT32?PCM32Coder::FLOAT32:PCM32Coder::INT32;
+  for (int ch=0;ch<numchannels_;ch++) {
+    enc_res[ch].Reset();
+    RangeCoderSH rc(enc_res[ch]);
+    rc.Init();
+    PCM32Coder pc(fmt);
+    pc.Split(rc,&(samples[ch][0]),numsamples_);
+    rc.Stop();
+  }
+}
+
+void FrameCoder::MergeSamples()
+{
+  const auto fmt=sample_fmt_==FLOAT32?PCM32Coder::FLOAT32:PCM32Coder::INT32;
+  for (int ch=0;ch<numchannels_;ch++) {
+    BufIO &buf=encoded[ch];
+    buf.Reset();
+    buf.SetBufPos(4+BitUtils::get32LH(&(buf.GetBuf()[0])));
+    RangeCoderSH rc(buf,1);
+    rc.Init();
+    PCM32Coder pc(fmt);
+    pc.Merge(rc,&(samples[ch][0]),numsamples_);
+  }
+}
+
 void FrameCoder::Predict()
 {
+  if (sample_fmt_!=PCM) SplitSamples();
   for (int ch=0;ch<numchannels_;ch++)
   {
     AnalyseMonoChannel(ch,numsamples_);
@@ -456,7 +711,7 @@ void FrameCoder::Predict()
     // reset profile params
     // otherwise: starting point for optimization is the best point from the last frame
     if (opt.ocfg.reset)
-      base_profile.LoadBaseProfile();
+      base_profile.LoadBaseProfile(opt.ols_solver);
 
     // optimize all params
     std::vector<int>lparam_base(base_profile.coefs.size());
@@ -471,18 +726,13 @@ void FrameCoder::Predict()
 void FrameCoder::Unpredict()
 {
   UnpredictFrame(base_profile,numsamples_);
+  if (sample_fmt_!=PCM) MergeSamples();
 }
 
 void FrameCoder::Encode()
 {
   if (opt.mt_mode && numchannels_>1)  {
-    std::vector <std::thread> threads;
-    for (int ch=0;ch<numchannels_;ch++) {
-      threads.emplace_back(&FrameCoder::EncodeMonoFrame,this,ch,numsamples_);
-    }
-    for (auto& t : threads) {
-        t.join();
-    }
+    ThreadPool::Shared().ParallelFor(numchannels_,[this](int ch){EncodeMonoFrame(ch,numsamples_);});
   } else {
     for (int ch=0;ch<numchannels_;ch++) EncodeMonoFrame(ch,numsamples_);
   }
@@ -491,13 +741,7 @@ void FrameCoder::Encode()
 void FrameCoder::Decode()
 {
   if (opt.mt_mode && numchannels_>1) {
-    std::vector <std::thread> threads;
-    for (int ch=0;ch<numchannels_;ch++) {
-      threads.emplace_back(&FrameCoder::DecodeMonoFrame,this,ch,numsamples_);
-    }
-    for (auto& t : threads) {
-        t.join();
-    }
+    ThreadPool::Shared().ParallelFor(numchannels_,[this](int ch){DecodeMonoFrame(ch,numsamples_);});
   } else {
     for (int ch=0;ch<numchannels_;ch++) {
         DecodeMonoFrame(ch, numsamples_);
@@ -528,9 +772,8 @@ void FrameCoder::DecodeProfile(SacProfile &profile,const std::vector <uint8_t>&b
   }
 }
 
-int FrameCoder::WriteBlockHeader(std::fstream &file, const std::vector<SacProfile::FrameStats> &framestats,int ch)
+void FrameCoder::PutBlockHeader(uint8_t *buf, const std::vector<SacProfile::FrameStats> &framestats,int ch)
 {
-  uint8_t buf[32];
   BitUtils::put32LH(buf,framestats[ch].blocksize);
   BitUtils::put32LH(buf+4,static_cast<uint32_t>(framestats[ch].mean));
   BitUtils::put32LH(buf+8,static_cast<uint32_t>(framestats[ch].minval));
@@ -543,15 +786,10 @@ int FrameCoder::WriteBlockHeader(std::fstream &file, const std::vector<SacProfil
     flag|=framestats[ch].maxbpn;
   }
   BitUtils::put16LH(buf+16,flag);
-  file.write(reinterpret_cast<char*>(buf),18);
-  return 18;
 }
 
-int FrameCoder::ReadBlockHeader(std::fstream &file, std::vector<SacProfile::FrameStats> &framestats,int ch)
+void FrameCoder::GetBlockHeader(const uint8_t *buf, std::vector<SacProfile::FrameStats> &framestats,int ch)
 {
-  uint8_t buf[32];
-  file.read(reinterpret_cast<char*>(buf),18);
-
   framestats[ch].blocksize=BitUtils::get32LH(buf);
   framestats[ch].mean=static_cast<int32_t>(BitUtils::get32LH(buf+4));
   framestats[ch].minval=static_cast<int32_t>(BitUtils::get32LH(buf+8));
@@ -560,37 +798,143 @@ int FrameCoder::ReadBlockHeader(std::fstream &file, std::vector<SacProfile::Fram
   if (flag>>9) framestats[ch].enc_mapped=true;
   else framestats[ch].enc_mapped=false;
   framestats[ch].maxbpn=flag&0xff;
-  return 18;
 }
 
+int FrameCoder::WriteBlockHeader(std::iostream &file, const std::vector<SacProfile::FrameStats> &framestats,int ch)
+{
+  uint8_t buf[32];
+  PutBlockHeader(buf,framestats,ch);
+  file.write(reinterpret_cast<char*>(buf),block_hdr_size);
+  return block_hdr_size;
+}
+
+int FrameCoder::ReadBlockHeader(std::iostream &file, std::vector<SacProfile::FrameStats> &framestats,int ch)
+{
+  uint8_t buf[32];
+  file.read(reinterpret_cast<char*>(buf),block_hdr_size);
+  GetBlockHeader(buf,framestats,ch);
+  return block_hdr_size;
+}
+
+// frame: numsamples, [crc32c], profile, per channel block header + data.
+// The crc covers everything but itself
 void FrameCoder::WriteEncoded(AudioFile &fout)
 {
-  uint8_t buf[12];
+  uint8_t buf[8];
   BitUtils::put32LH(buf,numsamples_);
-  fout.file.write(reinterpret_cast<char*>(buf),4);
   std::vector <uint8_t>profile_buf(profile_size_bytes_);
   EncodeProfile(base_profile,profile_buf);
-  fout.file.write(reinterpret_cast<char*>(&profile_buf[0]),profile_size_bytes_);
+  std::vector <std::array<uint8_t,block_hdr_size>> hdr(numchannels_);
   for (int ch=0;ch<numchannels_;ch++) {
     framestats[ch].blocksize = encoded[ch].GetBufPos();
-    WriteBlockHeader(fout.file, framestats, ch);
+    PutBlockHeader(hdr[ch].data(),framestats,ch);
+  }
+
+  fout.file.write(reinterpret_cast<char*>(buf),4);
+  if (frame_crc_) {
+    uint32_t crc=SIMD::kernels->crc32c(0,buf,4);
+    crc=SIMD::kernels->crc32c(crc,profile_buf.data(),profile_size_bytes_);
+    for (int ch=0;ch<numchannels_;ch++) {
+      crc=SIMD::kernels->crc32c(crc,hdr[ch].data(),block_hdr_size);
+      crc=SIMD::kernels->crc32c(crc,encoded[ch].GetBuf().data(),framestats[ch].blocksize);
+    }
+    BitUtils::put32LH(buf+4,crc);
+    fout.file.write(reinterpret_cast<char*>(buf+4),4);
+  }
+  fout.file.write(reinterpret_cast<char*>(&profile_buf[0]),profile_size_bytes_);
+  for (int ch=0;ch<numchannels_;ch++) {
+    fout.file.write(reinterpret_cast<char*>(hdr[ch].data()),block_hdr_size);
     fout.WriteData(encoded[ch].GetBuf(),framestats[ch].blocksize);
   }
 }
 
+// with frame crcs a damaged frame is flagged (FrameOK) instead of trusted,
+// an implausible length or block size stops reading it
 void FrameCoder::ReadEncoded(AudioFile &fin)
 {
   uint8_t buf[8];
   fin.file.read(reinterpret_cast<char*>(buf),4);
   numsamples_=BitUtils::get32LH(buf);
+  crc_ok_=true;
+  if (!fin.file) numsamples_=0;
+  if (numsamples_==0) return; // end of frames (streamed) or truncated
+  uint32_t crc_stored=0;
+  if (frame_crc_) {
+    fin.file.read(reinterpret_cast<char*>(buf+4),4);
+    crc_stored=BitUtils::get32LH(buf+4);
+    if (numsamples_<0 || numsamples_>framesize_) {numsamples_=0;crc_ok_=false;return;}
+  }
   std::vector <uint8_t>profile_buf(profile_size_bytes_);
   fin.file.read(reinterpret_cast<char*>(&profile_buf[0]),profile_size_bytes_);
   DecodeProfile(base_profile,profile_buf);
 
+  uint32_t crc=0;
+  if (frame_crc_) {
+    crc=SIMD::kernels->crc32c(crc,buf,4);
+    crc=SIMD::kernels->crc32c(crc,profile_buf.data(),profile_size_bytes_);
+  }
+  const uint32_t max_blocksize=16u*framesize_+65536u;
   for (int ch=0;ch<numchannels_;ch++) {
-    ReadBlockHeader(fin.file, framestats, ch);
+    uint8_t hdr[block_hdr_size];
+    fin.file.read(reinterpret_cast<char*>(hdr),block_hdr_size);
+    GetBlockHeader(hdr,framestats,ch);
+    // the frame end is lost, a caller without an index has to stop here
+    if (frame_crc_ && static_cast<uint32_t>(framestats[ch].blocksize)>max_blocksize) {numsamples_=0;crc_ok_=false;return;}
     fin.ReadData(encoded[ch].GetBuf(),framestats[ch].blocksize);
+    if (frame_crc_) {
+      crc=SIMD::kernels->crc32c(crc,hdr,block_hdr_size);
+      crc=SIMD::kernels->crc32c(crc,encoded[ch].GetBuf().data(),framestats[ch].blocksize);
+    }
   }
+  if (frame_crc_) crc_ok_=fin.file && crc==crc_stored;
+}
+
+// same layout as WriteEncoded without the frame crc, into memory
+std::size_t FrameCoder::PackEncoded(std::vector<uint8_t> &buf)
+{
+  std::size_t size=4+profile_size_bytes_;
+  for (int ch=0;ch<numchannels_;ch++) {
+    framestats[ch].blocksize = encoded[ch].GetBufPos();
+    size+=block_hdr_size+framestats[ch].blocksize;
+  }
+  buf.resize(size);
+
+  BitUtils::put32LH(&buf[0],numsamples_);
+  std::vector <uint8_t>profile_buf(profile_size_bytes_);
+  EncodeProfile(base_profile,profile_buf);
+  std::copy_n(profile_buf.begin(),profile_size_bytes_,buf.begin()+4);
+  std::size_t ofs=4+profile_size_bytes_;
+  for (int ch=0;ch<numchannels_;ch++) {
+    PutBlockHeader(&buf[ofs],framestats,ch);
+    ofs+=block_hdr_size;
+    std::copy_n(encoded[ch].GetBuf().begin(),framestats[ch].blocksize,buf.begin()+ofs);
+    ofs+=framestats[ch].blocksize;
+  }
+  return size;
+}
+
+// returns the number of bytes consumed, 0 if buf holds no complete frame
+std::size_t FrameCoder::UnpackEncoded(const uint8_t *buf,std::size_t len)
+{
+  if (len<4+static_cast<std::size_t>(profile_size_bytes_)) return 0;
+  numsamples_=BitUtils::get32LH(buf);
+  if (numsamples_<=0 || numsamples_>framesize_) {numsamples_=0;return 0;}
+  std::vector <uint8_t>profile_buf(buf+4,buf+4+profile_size_bytes_);
+  DecodeProfile(base_profile,profile_buf);
+
+  std::size_t ofs=4+profile_size_bytes_;
+  for (int ch=0;ch<numchannels_;ch++) {
+    if (len-ofs<static_cast<std::size_t>(block_hdr_size)) return 0;
+    GetBlockHeader(buf+ofs,framestats,ch);
+    ofs+=block_hdr_size;
+    const std::size_t blocksize=framestats[ch].blocksize;
+    if (len-ofs<blocksize) return 0;
+    std::vector <uint8_t>&data=encoded[ch].GetBuf();
+    if (data.size()<blocksize) data.resize(blocksize);
+    std::copy_n(buf+ofs,blocksize,data.begin());
+    ofs+=blocksize;
+  }
+  return ofs;
 }
 
 double FrameCoder::AnalyseStereoChannel(int ch0, int ch1, int numsamples)
@@ -653,6 +997,12 @@ void FrameCoder::AnalyseMonoChannel(int ch, int numsamples)
 
 void Codec::PrintProgress(int samplesprocessed,int totalsamples)
 {
+  if (opt_.quiet) return;
+  if (totalsamples<=0) { // unknown length
+    std::cout << "  " << samplesprocessed << "\r";
+    std::cout.flush();
+    return;
+  }
   double r=samplesprocessed*100.0/(double)totalsamples;
   std::cout << "  " << samplesprocessed << "/" << totalsamples << ":" << std::setw(6) << miscUtils::ConvertFixed(r,1) << "%\r";
   std::cout.flush();
@@ -670,11 +1020,18 @@ void Codec::ScanFrames(Sac &mySac)
   int frame_num=1;
   int coef_hdr_size=0;
   int block_hdr_size=0;
-  while (mySac.file.tellg()<fsize) {
+  int samplesscanned=0;
+  while (samplesscanned<mySac.getNumSamples() && mySac.file.tellg()<fsize) {
     uint8_t buf[12];
     mySac.file.read(reinterpret_cast<char*>(buf),4);
     int numsamples=BitUtils::get32LH(buf);
-    std::cout << "Frame " << frame_num << ": " << numsamples << " samples "<< std::endl;
+    samplesscanned+=numsamples;
+    std::cout << "Frame " << frame_num << ": " << numsamples << " samples";
+    if (mySac.mcfg.flags&Sac::FRAMECRC) {
+      mySac.file.read(reinterpret_cast<char*>(buf),4);
+      std::cout << ", crc " << std::hex << BitUtils::get32LH(buf) << std::dec;
+    }
+    std::cout << std::endl;
 
     mySac.file.seekg(size_profile_bytes,std::ios_base::cur); // skip profile coefs
     coef_hdr_size += size_profile_bytes;
@@ -692,6 +1049,7 @@ void Codec::ScanFrames(Sac &mySac)
   }
   std::cout << "Frames   " << (frame_num-1) << '\n';
   std::cout << "Hdr_size " << (coef_hdr_size+block_hdr_size) << " (coefs " << coef_hdr_size << ",block " << block_hdr_size << ")\n";
+  if (mySac.seektable.size()) std::cout << "Seektable " << mySac.seektable.size() << " entries\n";
 }
 
 
@@ -785,32 +1143,152 @@ std::vector<Codec::tsub_frame> Codec::Analyse(const std::vector <std::vector<int
 
 void Codec::EncodeFile(Wav &myWav,Sac &mySac)
 {
+  // a resumed run keeps the stream layout of the checkpoint
+  if (resume_) {
+    opt_.max_framelen=resume_->max_framelen;
+    opt_.seek_table=(resume_->flags&Sac::SEEKTABLE)!=0;
+    opt_.frame_crc=(resume_->flags&Sac::FRAMECRC)!=0;
+    opt_.hash=(resume_->flags&Sac::XXHASH)?AudioHash::HASH_XXH64:AudioHash::HASH_MD5;
+  }
   uint32_t max_framesize=static_cast<uint32_t>(opt_.max_framelen)*myWav.getSampleRate();
 
   const int numchannels=myWav.getNumChannels();
 
-  FrameCoder myFrame(numchannels,max_framesize,opt_);
+  // frames are coded independently, so we keep a window of frame_threads
+  // coders in flight and write them back in order (frame i uses coder i%n)
+  const int nframe_threads=std::max(1,opt_.frame_threads);
+  ThreadPool &pool=ThreadPool::Shared();
+  std::vector<std::unique_ptr<FrameCoder>> coders;
+  for (int i=0;i<nframe_threads;i++)
+    coders.emplace_back(std::make_unique<FrameCoder>(numchannels,max_framesize,opt_));
+  const FrameCoder::SampleFormat sample_fmt=FrameCoder::GetSampleFormat(myWav);
+  for (auto &coder:coders) coder->SetSampleFormat(sample_fmt);
+
+  // without seeks (or a known length) the digest and numsamples go to a trailer
+  const bool streamed=mySac.isStreamed() || myWav.getNumSamples()<0;
+  const bool seek_table=opt_.seek_table && !streamed;
+  if (opt_.seek_table && !seek_table) std::cerr << "  warning: no seek table in streaming mode\n";
+  const bool checkpoint=ckpt_file_.size() && !streamed && !myWav.isStreamed();
+  if (ckpt_file_.size() && !checkpoint) std::cerr << "  warning: no checkpoints in streaming mode\n";
+  const Checkpoint *resume=checkpoint?resume_:nullptr;
 
   mySac.mcfg.max_framelen = opt_.max_framelen;
-
-  mySac.WriteSACHeader(myWav);
-  std::streampos hdrpos = mySac.file.tellg();
-  mySac.WriteMD5(myWav.md5ctx.digest);
+  if (seek_table) mySac.mcfg.flags|=Sac::SEEKTABLE;
+  if (streamed) mySac.mcfg.flags|=Sac::STREAMED;
+  if (opt_.hash==AudioHash::HASH_XXH64) mySac.mcfg.flags|=Sac::XXHASH;
+  if (opt_.frame_crc) mySac.mcfg.flags|=Sac::FRAMECRC;
+  for (auto &coder:coders) coder->SetFrameCRC(opt_.frame_crc);
+  mySac.seektable.clear();
+  myWav.hash.Init(mySac.GetHashType());
+
+  std::streampos hdrpos=0;
+  int samplescoded=0;
+  if (resume) {
+    // header and the frames up to the checkpoint are in place already
+    mySac.mcfg.flags=resume->flags;
+    hdrpos=static_cast<std::streamoff>(resume->hdrpos);
+    mySac.file.seekg(static_cast<std::streamoff>(resume->sacpos));
+    myWav.SeekSamples(static_cast<int>(resume->samplescoded));
+    myWav.hash=resume->hash;
+    mySac.seektable=resume->seektable;
+    samplescoded=static_cast<int>(resume->samplescoded);
+    for (auto &coder:coders)
+      if (coder->GetProfile().coefs.size()==resume->profile.coefs.size()) coder->SetProfile(resume->profile);
+  } else {
+    mySac.WriteSACHeader(myWav);
+    hdrpos = streamed?std::streampos(0):mySac.file.tellg();
+    uint8_t zero_digest[16]={0};
+    mySac.WriteMD5(zero_digest);
+  }
   myWav.InitFileBuf(max_framesize);
 
-  Timer gtimer,ltimer;
+  // checkpoints are taken when the first frame of a read block retires:
+  // everything before it is written and the block start hash is exact
+  Checkpoint ckpt;
+  if (checkpoint) {
+    ckpt.numchannels=myWav.getNumChannels();
+    ckpt.samplerate=myWav.getSampleRate();
+    ckpt.bitspersample=myWav.getBitsPerSample();
+    ckpt.numsamples=myWav.getNumSamples();
+    ckpt.max_framelen=mySac.mcfg.max_framelen;
+    ckpt.flags=mySac.mcfg.flags;
+    ckpt.hdrpos=static_cast<uint64_t>(static_cast<std::streamoff>(hdrpos));
+  }
+  const int samples_resumed=samplescoded;
+  SacProfile last_profile=coders[0]->GetProfile(); // of the last retired frame, seeds the next
+
+  Timer gtimer;
   double time_prd=0,time_enc=0;
 
-  gtimer.start();
-  int samplescoded=0;
-  int samplestocode=myWav.getNumSamples();
-  std::vector<std::vector<int32_t>> csamples(myWav.getNumChannels(),std::vector<int32_t>(max_framesize));
+  struct tframe_job {
+    FrameCoder *coder;
+    std::future<std::pair<double,double>> task;
+    bool block_start=false;
+    AudioHash block_hash=AudioHash(); // pcm hash up to the block, if block_start
+  };
+  std::deque<FrameCoder*> free_coders;
+  for (auto &coder:coders) free_coders.push_back(coder.get());
+  std::deque<tframe_job> jobs; // reorder buffer
+
+  auto retire_frame=[&]() {
+    tframe_job &job=jobs.front();
+    auto timing=(nframe_threads>1)?pool.Wait(job.task):job.task.get();
+    time_prd+=timing.first;
+    time_enc+=timing.second;
+    if (checkpoint && job.block_start && samplescoded>samples_resumed) {
+      mySac.file.flush();
+      ckpt.samplescoded=samplescoded;
+      ckpt.sacpos=static_cast<uint64_t>(static_cast<std::streamoff>(mySac.file.tellg()));
+      ckpt.hash=job.block_hash;
+      ckpt.profile=last_profile;
+      ckpt.seektable=mySac.seektable;
+      if (ckpt.Save(ckpt_file_)!=0) std::cerr << "  warning: could not write checkpoint '" << ckpt_file_ << "'\n";
+    }
+    last_profile=job.coder->GetProfile();
+    if (seek_table) {
+      Sac::tseek_entry entry;
+      entry.pos=static_cast<uint64_t>(mySac.file.tellg());
+      entry.start=samplescoded;
+      entry.numsamples=job.coder->GetNumSamples();
+      mySac.seektable.push_back(entry);
+    }
+    job.coder->WriteEncoded(mySac);
+
+    samplescoded+=job.coder->GetNumSamples();
+    PrintProgress(samplescoded,myWav.getNumSamples());
+    free_coders.push_back(job.coder);
+    jobs.pop_front();
+  };
+
+  auto code_frame=[](FrameCoder *coder) {
+    Timer ltimer;
+    std::pair<double,double> timing;
+    ltimer.start();coder->Predict();ltimer.stop();timing.first=ltimer.elapsedS();
+    ltimer.start();coder->Encode();ltimer.stop();timing.second=ltimer.elapsedS();
+    return timing;
+  };
 
-  while (samplestocode>0) {
-      int samplesread=myWav.ReadSamples(csamples,max_framesize);
+  gtimer.start();
+  // double buffered read-ahead: the next block is read on the io worker
+  // while the current one is split into frames and coded
+  std::vector<std::vector<int32_t>> cbuf[2];
+  for (auto &buf:cbuf) buf.assign(myWav.getNumChannels(),std::vector<int32_t>(max_framesize));
+  auto read_block=[&myWav,&cbuf,max_framesize](int idx) {return myWav.ReadSamples(cbuf[idx],max_framesize);};
+
+  int curbuf=0;
+  IOWorker &io=IOWorker::Shared();
+  std::future<int> next_block=io.Submit([&read_block,curbuf]{return read_block(curbuf);});
+  int samplesread;
+  while ((samplesread=io.Wait(next_block))>0) {
+      // frames copy their samples out below, so the other buffer is free
+      const std::vector<std::vector<int32_t>> &csamples=cbuf[curbuf];
+      const AudioHash block_hash=myWav.BlockStartHash();
+      curbuf^=1;
+      next_block=io.Submit([&read_block,curbuf]{return read_block(curbuf);});
 
       std::vector<Codec::tsub_frame> sub_frames;
-      if (opt_.adapt_block) {
+      // sub frames follow the sparse pcm state, which 32 bit formats don't use
+      if (opt_.adapt_block && sample_fmt==FrameCoder::PCM) {
         int block_len=myWav.getSampleRate()*3;
         int min_frame_len=myWav.getSampleRate()*3;
         sub_frames=Analyse(csamples,block_len,min_frame_len,samplesread);
@@ -820,67 +1298,300 @@ void Codec::EncodeFile(Wav &myWav,Sac &mySac)
 
       for (auto &subframe:sub_frames)
       {
-        if (opt_.verbose_level)
+        if (opt_.verbose_level && !opt_.quiet)
           std::cout << "frame " << subframe.start << " state " << subframe.state << " len " << subframe.length << '\n';
 
-        for (int ch=0;ch<myWav.getNumChannels();ch++)
-          std::copy_n(&csamples[ch][subframe.start],subframe.length,&myFrame.samples[ch][0]);
+        if (free_coders.empty()) retire_frame();
+        FrameCoder *coder=free_coders.front();
+        free_coders.pop_front();
 
-        myFrame.SetNumSamples(subframe.length);
+        // the optimizer starts from the last retired frame, frame k-n with n
+        // frame threads, so optimized output depends on --frame-threads
+        if (opt_.optimize) coder->SetProfile(last_profile);
+        for (int ch=0;ch<myWav.getNumChannels();ch++)
+          std::copy_n(&csamples[ch][subframe.start],subframe.length,&coder->samples[ch][0]);
 
-        ltimer.start();myFrame.Predict();ltimer.stop();time_prd+=ltimer.elapsedS();
-        ltimer.start();myFrame.Encode();ltimer.stop();time_enc+=ltimer.elapsedS();
-        myFrame.WriteEncoded(mySac);
+        coder->SetNumSamples(subframe.length);
 
-        samplescoded+=subframe.length;
-        PrintProgress(samplescoded,myWav.getNumSamples());
-        samplestocode-=subframe.length;
+        if (nframe_threads>1)
+          jobs.push_back({coder,pool.Submit([code_frame,coder]{return code_frame(coder);})});
+        else
+          jobs.push_back({coder,std::async(std::launch::deferred,code_frame,coder)});
+        if (checkpoint && &subframe==&sub_frames.front()) {
+          jobs.back().block_start=true;
+          jobs.back().block_hash=block_hash;
+        }
       }
   }
-  MD5::Finalize(&myWav.md5ctx);
+  while (jobs.size()) retire_frame();
+  if (seek_table && mySac.WriteSeekTable()!=0) std::cerr << "  warning: seek table too large, not written\n";
+
+  myWav.FinishHash();
   gtimer.stop();
   double time_total=gtimer.elapsedS();
-  if (time_total>0.)   {
+  if (nframe_threads>1) time_total=time_prd+time_enc; // summed over workers
+  if (time_total>0. && !opt_.quiet)   {
      double rprd=time_prd*100./time_total;
      double renc=time_enc*100./time_total;
      std::cout << "\n  Timing:  pred " << miscUtils::ConvertFixed(rprd,2) << "%, ";
      std::cout << "enc " << miscUtils::ConvertFixed(renc,2) << "%, ";
      std::cout << "misc " << miscUtils::ConvertFixed(100.-rprd-renc,2) << "%" << std::endl;
   }
-  std::cout << "  MD5:     ";
-  for (auto x : myWav.md5ctx.digest) std::cout << std::hex << (int)x;
-  std::cout << std::dec << '\n';
+  if (!opt_.quiet) {
+    std::cout << "  " << std::left << std::setw(9) << (std::string(myWav.hash.Name())+":") << std::right;
+    for (int i=0;i<myWav.hash.Size();i++) std::cout << std::hex << (int)myWav.hash.digest[i];
+    std::cout << std::dec << '\n';
+  }
 
-  std::streampos eofpos = mySac.file.tellg();
-  mySac.file.seekg(hdrpos);
-  mySac.WriteMD5(myWav.md5ctx.digest);
-  mySac.file.seekg(eofpos);
+  if (streamed) {
+    myWav.setNumSamples(samplescoded);
+    mySac.setNumSamples(samplescoded);
+    mySac.WriteTrailer(myWav.hash.digest);
+  } else {
+    std::streampos eofpos = mySac.file.tellg();
+    mySac.file.seekg(hdrpos);
+    mySac.WriteMD5(myWav.hash.digest);
+    mySac.file.seekg(eofpos);
+  }
+  if (checkpoint) {
+    std::error_code ec;
+    std::filesystem::remove(ckpt_file_,ec);
+  }
 }
 
-void Codec::DecodeFile(Sac &mySac,Wav &myWav)
+void Codec::DecodeFile(Sac &mySac,Wav &myWav,bool verify_only)
 {
   const Sac::sac_cfg &cfg=mySac.mcfg;
-  myWav.InitFileBuf(cfg.max_framesize);
+  myWav.hash.Init(mySac.GetHashType());
   mySac.UnpackMetaData(myWav);
-  myWav.WriteHeader();
+  if (!verify_only) {
+    myWav.InitFileBuf(cfg.max_framesize);
+    myWav.WriteHeader();
+  }
 
   opt_.max_framelen=cfg.max_framelen;
-  FrameCoder myFrame(mySac.getNumChannels(),cfg.max_framesize,opt_);
+  const int nframe_threads=std::max(1,opt_.frame_threads);
+  ThreadPool &pool=ThreadPool::Shared();
+
+  // frames are self-contained: with several frame threads we locate them
+  // first, then decode a window of frames on workers and write the pcm back
+  // in order. Streams are read sequentially, streamed files until the marker
+  const bool until_marker=(cfg.flags&Sac::STREAMED) && (mySac.isStreamed() || mySac.getNumSamples()<0);
+  const bool use_index=nframe_threads>1 && !mySac.isStreamed() && !until_marker;
+  std::vector<Sac::tseek_entry> frames;
+  if (use_index) frames=mySac.seektable.size()?mySac.seektable:IndexFrames(mySac);
+
+  std::vector<std::unique_ptr<FrameCoder>> coders;
+  for (int i=0;i<nframe_threads;i++)
+    coders.emplace_back(std::make_unique<FrameCoder>(mySac.getNumChannels(),cfg.max_framesize,opt_));
+  for (auto &coder:coders) {
+    coder->SetSampleFormat(FrameCoder::GetSampleFormat(mySac));
+    coder->SetStreamFormat(cfg.format);
+    coder->SetFrameCRC(cfg.flags&Sac::FRAMECRC);
+  }
+
+  struct tframe_job {
+    FrameCoder *coder;
+    std::future<double> task; // decode time in seconds
+  };
+  std::deque<FrameCoder*> free_coders;
+  for (auto &coder:coders) free_coders.push_back(coder.get());
+  std::deque<tframe_job> jobs;
 
   int64_t data_nbytes=0;
-  int samplestodecode=mySac.getNumSamples();
   int samplesdecoded=0;
-  while (samplestodecode>0) {
-    myFrame.ReadEncoded(mySac);
-    myFrame.Decode();
-    myFrame.Unpredict();
-    data_nbytes += myWav.WriteSamples(myFrame.samples,myFrame.GetNumSamples());
+  std::vector<double> frame_speed; // per frame, x realtime
+  int nframes=0,nbad_frames=0;
+  auto retire_frame=[&]() {
+    tframe_job &job=jobs.front();
+    const double time_dec=(nframe_threads>1)?pool.Wait(job.task):job.task.get();
+    nframes++;
+    if (!job.coder->FrameOK()) {
+      std::cerr << "  warning: frame " << nframes << " (samples " << samplesdecoded << "-" << (samplesdecoded+job.coder->GetNumSamples()-1) << ") crc mismatch, skipped\n";
+      nbad_frames++;
+    }
+    const double frame_len=job.coder->GetNumSamples()/static_cast<double>(mySac.getSampleRate());
+    if (time_dec>0.) frame_speed.push_back(frame_len/time_dec);
+    if (opt_.verbose_level && !opt_.quiet)
+      std::cout << "frame " << frame_speed.size() << " len " << job.coder->GetNumSamples() << " time " << miscUtils::ConvertFixed(time_dec,3) << "s\n";
+
+    // written behind on the io worker, the coder is free again right away
+    if (verify_only) data_nbytes += myWav.HashSamples(job.coder->samples,job.coder->GetNumSamples());
+    else data_nbytes += myWav.WriteSamplesAsync(job.coder->samples,job.coder->GetNumSamples());
 
-    samplesdecoded+=myFrame.GetNumSamples();
+    samplesdecoded+=job.coder->GetNumSamples();
     PrintProgress(samplesdecoded,myWav.getNumSamples());
-    samplestodecode-=myFrame.GetNumSamples();
+    free_coders.push_back(job.coder);
+    jobs.pop_front();
+  };
+
+  std::size_t iframe=0;
+  int samplesread=0;
+  auto read_frame=[&](FrameCoder *coder) {
+    if (use_index) {
+      if (iframe>=frames.size()) return false;
+      mySac.file.seekg(static_cast<std::streamoff>(frames[iframe++].pos));
+    } else if (!until_marker && samplesread>=mySac.getNumSamples()) return false;
+    coder->ReadEncoded(mySac);
+    if (!coder->FrameOK()) {
+      // a seek table tells the length of the frame and where the next starts,
+      // the damaged header may have left the file anywhere
+      const auto &st=mySac.seektable;
+      auto it=std::find_if(st.begin(),st.end(),[samplesread](const Sac::tseek_entry &e){return e.start==static_cast<uint32_t>(samplesread);});
+      if (!mySac.isStreamed() && it!=st.end()) {
+        coder->SetDamaged(static_cast<int>(it->numsamples));
+        mySac.file.clear();
+        if (it+1!=st.end()) mySac.file.seekg(static_cast<std::streamoff>((it+1)->pos));
+      } else if (coder->GetNumSamples()==0) std::cerr << "  warning: damaged frame header, decoding stopped\n";
+    }
+    samplesread+=coder->GetNumSamples();
+    return coder->GetNumSamples()>0;
+  };
+
+  while (true) {
+    if (free_coders.empty()) retire_frame();
+    FrameCoder *coder=free_coders.front();
+    if (!read_frame(coder)) break;
+    free_coders.pop_front();
+
+    auto decode_frame=[coder]{
+      // a damaged frame keeps its length, as silence
+      if (!coder->FrameOK()) {
+        for (auto &ch_samples:coder->samples) std::fill_n(ch_samples.begin(),coder->GetNumSamples(),0);
+        return 0.;
+      }
+      Timer ltimer;
+      ltimer.start();coder->Decode();coder->Unpredict();ltimer.stop();
+      return ltimer.elapsedS();
+    };
+    if (nframe_threads>1) jobs.push_back({coder,pool.Submit(decode_frame)});
+    else jobs.push_back({coder,std::async(std::launch::deferred,decode_frame)});
   }
+  while (jobs.size()) retire_frame();
+  myWav.Flush();
+
+  if (until_marker) {
+    if (mySac.isStreamed() && mySac.ReadTrailer()!=0) std::cerr << "  warning: missing trailer\n";
+    if (mySac.getNumSamples()!=samplesdecoded) std::cerr << "  warning: numsamples mismatch\n";
+    mySac.setNumSamples(samplesdecoded);
+    myWav.setNumSamples(samplesdecoded);
+  }
+  if (nbad_frames) std::cerr << "  warning: " << nbad_frames << " of " << nframes << " frames damaged\n";
+  if (frame_speed.size() && !opt_.quiet) {
+    const auto [smin,smax]=std::minmax_element(frame_speed.begin(),frame_speed.end());
+    double ssum=0.;
+    for (double x:frame_speed) ssum+=x;
+    std::cout << "\n  Frames:  " << frame_speed.size() << ", per frame ";
+    std::cout << miscUtils::ConvertFixed(*smin,3) << "x min, ";
+    std::cout << miscUtils::ConvertFixed(ssum/frame_speed.size(),3) << "x avg, ";
+    std::cout << miscUtils::ConvertFixed(*smax,3) << "x max";
+  }
+  if (verify_only) return;
+
   // pad odd sized data chunk
   if (data_nbytes&1) myWav.WriteData(std::vector<uint8_t>{0},1);
   myWav.WriteHeader();
 }
+
+// decodes only the frames covering [start,start+len) and writes that range,
+// the frame offsets come from the seek table or from scanning the file
+int Codec::DecodeRange(Sac &mySac,Wav &myWav,int64_t start,int64_t len)
+{
+  const Sac::sac_cfg &cfg=mySac.mcfg;
+  if (mySac.isStreamed()) {
+    std::cerr << "  error: range decoding needs a seekable input\n";
+    return 1;
+  }
+  const int64_t end=std::min(start+len,static_cast<int64_t>(mySac.getNumSamples()));
+  if (start<0 || start>=end) {
+    std::cerr << "  error: invalid range\n";
+    return 1;
+  }
+  myWav.InitFileBuf(cfg.max_framesize);
+  myWav.WriteHeader();
+
+  opt_.max_framelen=cfg.max_framelen;
+  FrameCoder myFrame(mySac.getNumChannels(),cfg.max_framesize,opt_);
+  myFrame.SetSampleFormat(FrameCoder::GetSampleFormat(mySac));
+  myFrame.SetStreamFormat(cfg.format);
+  myFrame.SetFrameCRC(cfg.flags&Sac::FRAMECRC);
+  const std::vector<Sac::tseek_entry> frames=mySac.seektable.size()?mySac.seektable:IndexFrames(mySac);
+
+  std::vector<std::vector<int32_t>> range_samples(mySac.getNumChannels());
+  int64_t data_nbytes=0;
+  int64_t sampleswritten=0;
+  for (const auto &frame:frames) {
+    const int64_t fstart=frame.start;
+    const int64_t fend=fstart+frame.numsamples;
+    if (fend<=start) continue;
+    if (fstart>=end) break;
+
+    mySac.file.seekg(static_cast<std::streamoff>(frame.pos));
+    myFrame.ReadEncoded(mySac);
+    if (myFrame.FrameOK()) {
+      myFrame.Decode();
+      myFrame.Unpredict();
+    } else {
+      std::cerr << "  warning: frame at sample " << fstart << " crc mismatch, skipped\n";
+      // without a seek table the length is the damaged header's own
+      if (frame.numsamples>cfg.max_framesize) break;
+      myFrame.SetDamaged(static_cast<int>(frame.numsamples));
+      for (auto &ch_samples:myFrame.samples) std::fill_n(ch_samples.begin(),myFrame.GetNumSamples(),0);
+    }
+
+    // the decoded length bounds the slice, whatever the index said
+    const int64_t from=std::max(start,fstart);
+    const int nsamples=static_cast<int>(std::min({end,fend,fstart+myFrame.GetNumSamples()})-from);
+    if (nsamples<=0) break;
+    for (int ch=0;ch<mySac.getNumChannels();ch++)
+      range_samples[ch].assign(myFrame.samples[ch].begin()+(from-fstart),myFrame.samples[ch].begin()+(from-fstart)+nsamples);
+    data_nbytes += myWav.WriteSamplesAsync(range_samples,nsamples);
+    sampleswritten+=nsamples;
+    PrintProgress(static_cast<int>(sampleswritten),static_cast<int>(end-start));
+  }
+  myWav.Flush();
+  if (data_nbytes&1) myWav.WriteData(std::vector<uint8_t>{0},1);
+  myWav.WriteHeader();
+  if (sampleswritten!=end-start) {
+    std::cerr << "  warning: range incomplete (" << sampleswritten << " of " << (end-start) << " samples)\n";
+    return 1;
+  }
+  return 0;
+}
+
+// walk the frame headers from the current position and record where
+// each frame starts, the file position is restored afterwards
+std::vector<Sac::tseek_entry> Codec::IndexFrames(Sac &mySac)
+{
+  std::vector<Sac::tseek_entry> frames;
+  std::vector<SacProfile::FrameStats> framestats(mySac.getNumChannels());
+  const std::streampos startpos=mySac.file.tellg();
+  const std::streampos fsize=mySac.getFileSize();
+
+  SacProfile profile_tmp;
+  const int size_profile_bytes=profile_tmp.LoadBaseProfile()*4;
+  const int frame_crc_bytes=(mySac.mcfg.flags&Sac::FRAMECRC)?4:0;
+
+  uint32_t samplesindexed=0;
+  while (samplesindexed<static_cast<uint32_t>(mySac.getNumSamples()) && mySac.file.tellg()<fsize) {
+    Sac::tseek_entry frame;
+    frame.pos=static_cast<uint64_t>(mySac.file.tellg());
+    frame.start=samplesindexed;
+
+    uint8_t buf[4];
+    if (!mySac.file.read(reinterpret_cast<char*>(buf),4)) break;
+    frame.numsamples=BitUtils::get32LH(buf);
+    mySac.file.seekg(size_profile_bytes+frame_crc_bytes,std::ios_base::cur);
+
+    for (int ch=0;ch<mySac.getNumChannels();ch++) {
+      FrameCoder::ReadBlockHeader(mySac.file, framestats, ch);
+      mySac.file.seekg(framestats[ch].blocksize, std::ios_base::cur);
+    }
+    if (!mySac.file) break;
+    frames.push_back(frame);
+    samplesindexed+=frame.numsamples;
+  }
+  mySac.file.clear();
+  mySac.file.seekg(startpos);
+  return frames;
+}
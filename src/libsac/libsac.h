@@ -7,11 +7,13 @@
 #include "profile.h"
 #include "../opt/dds.h"
 #include "../opt/de.h"
+#include "../common/threadpool.h"
 
 class FrameCoder {
   public:
     enum SearchCost {L1,RMS,Entropy,Golomb,Bitplane};
     enum SearchMethod {DDS,DE};
+    enum SampleFormat {PCM,PCM32,FLOAT32}; // PCM: up to 24 bit, coded directly
 
     typedef std::vector <std::vector<int32_t>> tch_samples;
 
@@ -36,25 +38,50 @@ class FrameCoder {
       int stereo_ms=0;
       int mt_mode=2;
       int adapt_block=1;
+      int frame_threads=1;
+      int seek_table=0;
+      int hash=AudioHash::HASH_MD5; // pcm digest in the header
+      int frame_crc=0; // crc32c per frame
+      int ols_solver=0; // 0=cholesky, 1=rank-1 update, stored per frame
+      int sac2_fma=0; // 'SAC2' input was written by an fma build
+      int quiet=0; // no per-file console output (batch mode)
 
       toptim_cfg ocfg;
       SacProfile profiledata;
+
+      void SetPreset(int level); // 0=normal,1=high,..,5=insane
+      void ConfigureOpt(); // push search limits into the optimizer cfg
     };
     FrameCoder(int numchannels,int framesize,const coder_ctx &opt);
     void SetNumSamples(int nsamples){numsamples_=nsamples;};
     int GetNumSamples(){return numsamples_;};
+    void SetSampleFormat(SampleFormat fmt);
+    static SampleFormat GetSampleFormat(const AudioFile &file);
+    void SetFrameCRC(bool enable){frame_crc_=enable;};
+    void SetStreamFormat(int format){kernels_=(format<Sac::FORMAT && !opt.sac2_fma)?&SIMD::Legacy():SIMD::kernels;}; // predictor arithmetic of the stream
+    const SacProfile &GetProfile() const {return base_profile;};
+    void SetProfile(const SacProfile &profile){base_profile=profile;}; // optimizer start point
+    bool FrameOK() const {return crc_ok_;}; // crc of the last ReadEncoded frame matched
+    void SetDamaged(int nsamples){numsamples_=nsamples;crc_ok_=false;}; // decoded as silence
     void Predict();
     void Unpredict();
     void Encode();
     void Decode();
     void WriteEncoded(AudioFile &fout);
     void ReadEncoded(AudioFile &fin);
+    std::size_t PackEncoded(std::vector<uint8_t> &buf);
+    std::size_t UnpackEncoded(const uint8_t *buf,std::size_t len);
     std::vector <std::vector<int32_t>>samples,error,s2u_error,s2u_error_map,pred;
-    std::vector <BufIO> encoded,enc_temp1,enc_temp2;
+    std::vector <BufIO> encoded,enc_temp1,enc_temp2,enc_res;
     std::vector <SacProfile::FrameStats> framestats;
+    std::vector <BitplaneCoder> bpcoder,bpcoder_map; // one per channel and trial, Reset() per block
 
-    static int WriteBlockHeader(std::fstream &file, const std::vector<SacProfile::FrameStats> &framestats, int ch);
-    static int ReadBlockHeader(std::fstream &file, std::vector<SacProfile::FrameStats> &framestats, int ch);
+    static const int max_channels=256; // stored in 16 bit, this bounds the per channel state
+    static const int block_hdr_size=18;
+    static void PutBlockHeader(uint8_t *buf, const std::vector<SacProfile::FrameStats> &framestats, int ch);
+    static void GetBlockHeader(const uint8_t *buf, std::vector<SacProfile::FrameStats> &framestats, int ch);
+    static int WriteBlockHeader(std::iostream &file, const std::vector<SacProfile::FrameStats> &framestats, int ch);
+    static int ReadBlockHeader(std::iostream &file, std::vector<SacProfile::FrameStats> &framestats, int ch);
   private:
     void CnvError_S2U(tch_samples &error,int numsamples);
     void SetParam(Predictor::tparam &param,const SacProfile &profile,bool optimize=false);
@@ -65,21 +92,33 @@ class FrameCoder {
     double AnalyseStereoChannel(int ch0, int ch1, int numsamples);
     void ApplyMs(int ch0, int ch1, int numsamples);
     //void InterChannel(int ch0,int ch1,int numsamples);
-    int EncodeMonoFrame_Normal(int ch,int numsamples,BufIO &buf);
-    int EncodeMonoFrame_Mapped(int ch,int numsamples,BufIO &buf);
+    // limit: stop once the output is larger (returns -1), nullptr=never
+    int EncodeMonoFrame_Normal(int ch,int numsamples,BufIO &buf,const std::atomic<std::size_t> *limit=nullptr);
+    int EncodeMonoFrame_Mapped(int ch,int numsamples,BufIO &buf,const std::atomic<std::size_t> *limit=nullptr);
     void Optimize(const FrameCoder::toptim_cfg &ocfg,SacProfile &profile,const std::vector<int>&params_to_optimize);
     double GetCost(const CostFunction *func,const tch_samples &samples,std::size_t samples_to_optimize) const;
+    void GetChannelUnits(std::vector<std::pair<int,int>> &units) const; // (ch0,ch1), ch1=-1 for mono
+    void ForEachUnit(const std::function<void(int ch0,int ch1)> &func);
+    static int StereoLag(const Predictor::tparam &param,int idx0);
     void PredictFrame(const SacProfile &profile,tch_samples &error,int from,int numsamples,bool optimize);
     void UnpredictFrame(const SacProfile &profile,int numsamples);
     double CalcRemapError(int ch, int numsamples);
     void EncodeMonoFrame(int ch,int numsamples);
     void DecodeMonoFrame(int ch,int numsamples);
+    void SplitSamples(); // 32 bit formats: samples -> integer part, residual -> enc_res
+    void MergeSamples();
+    void AppendResidual(int ch);
     int numchannels_,framesize_,numsamples_;
     int profile_size_bytes_;
     SacProfile base_profile;
+    SampleFormat sample_fmt_;
+    bool frame_crc_,crc_ok_;
+    const SIMD::tkernels *kernels_;
     coder_ctx opt;
 };
 
+class Checkpoint;
+
 class Codec {
   struct tsub_frame {
     int state=-1;
@@ -91,15 +130,21 @@ class Codec {
     Codec(){};
     Codec(FrameCoder::coder_ctx &opt):opt_(opt) {};
     void EncodeFile(Wav &myWav,Sac &mySac);
+    // EncodeFile keeps a checkpoint in fname, resume_from continues a run
+    void SetCheckpoint(const std::string &fname,const Checkpoint *resume_from=nullptr) {ckpt_file_=fname;resume_=resume_from;};
     //void EncodeFile(Wav &myWav,Sac &mySac,int profile,int optimize,int sparse_pcm);
-    void DecodeFile(Sac &mySac,Wav &myWav);
+    void DecodeFile(Sac &mySac,Wav &myWav,bool verify_only=false); // verify_only: hash the pcm, write nothing
+    int DecodeRange(Sac &mySac,Wav &myWav,int64_t start,int64_t len);
     void ScanFrames(Sac &mySac);
+    std::vector<Sac::tseek_entry> IndexFrames(Sac &mySac);
   private:
     std::vector<Codec::tsub_frame> Analyse(const std::vector <std::vector<int32_t>>&samples,int blocksamples,int min_frame_length,int samples_read);
     void PushState(std::vector<Codec::tsub_frame> &sub_frames,Codec::tsub_frame &curframe,int min_frame_length,int block_state,int samples_block);
     std::pair<double,double> AnalyseSparse(span<const int32_t> buf);
     void PrintProgress(int samplesprocessed,int totalsamples);
     FrameCoder::coder_ctx opt_;
+    std::string ckpt_file_;
+    const Checkpoint *resume_=nullptr;
     //int framesize;
 };
 
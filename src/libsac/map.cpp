@@ -1,7 +1,7 @@
 #include "map.h"
 
-MapEncoder::MapEncoder(RangeCoderSH &rc,std::vector <bool>&usedl,std::vector <bool>&usedh)
-:rc(rc),mixl(4,NMixLogistic(5)),mixh(4,NMixLogistic(5)),finalmix(2),ul(usedl),uh(usedh)
+MapEncoder::MapEncoder(std::vector <bool>&usedl,std::vector <bool>&usedh)
+:mixl(4,NMixLogistic(5)),mixh(4,NMixLogistic(5)),finalmix(2),ul(usedl),uh(usedh)
 {
 }
 
@@ -70,37 +70,6 @@ void MapEncoder::UpdateSSE(int bit,int ctx)
   finalmix.Update(bit,mixsse_upd_rate);
 }
 
-void MapEncoder::Encode()
-{
-  for (int i=1;i<=1<<15;i++) {
-    int bit=ul[i];
-
-    rc.EncodeBitOne(PredictSSE(PredictLow(i),0),bit);
-    Update(bit);
-    UpdateSSE(bit,0);
-
-    bit=uh[i];
-    rc.EncodeBitOne(PredictSSE(PredictHigh(i),0),bit);
-    Update(bit);
-    UpdateSSE(bit,0);
-  }
-}
-
-void MapEncoder::Decode()
-{
-  for (int i=1;i<=1<<15;i++) {
-    int bit=rc.DecodeBitOne(PredictSSE(PredictLow(i),0));
-    Update(bit);
-    ul[i]=bit;
-    UpdateSSE(bit,0);
-
-    bit=rc.DecodeBitOne(PredictSSE(PredictHigh(i),0));
-    Update(bit);
-    uh[i]=bit;
-    UpdateSSE(bit,0);
-  }
-}
-
 Remap::Remap()
 :scale(1<<15),usedl(scale+1),usedh(scale+1)
 {
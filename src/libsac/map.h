@@ -13,16 +13,15 @@ class MapEncoder {
   const int mix_upd_rate=1000;
   const int mixsse_upd_rate=500;
   public:
-    MapEncoder(RangeCoderSH &rc,std::vector <bool>&usedl,std::vector <bool>&usedh);
-    void Encode();
-    void Decode();
+    MapEncoder(std::vector <bool>&usedl,std::vector <bool>&usedh);
+    template <class tcoder> void Encode(tcoder &rc);
+    template <class tcoder> void Decode(tcoder &rc);
   private:
     int PredictLow(int i);
     int PredictHigh(int i);
     void Update(int bit);
     int PredictSSE(int p1,int ctx);
     void UpdateSSE(int bit,int ctx);
-    RangeCoderSH &rc;
     LinearCounter16 cnt[24];
     LinearCounter16 cctx[256];
     LinearCounter16 *pc1,*pc2,*pc3,*pc4,*px;
@@ -33,6 +32,39 @@ class MapEncoder {
     std::vector <bool>&ul,&uh;
 };
 
+template <class tcoder>
+void MapEncoder::Encode(tcoder &rc)
+{
+  for (int i=1;i<=1<<15;i++) {
+    int bit=ul[i];
+
+    rc.EncodeBitOne(PredictSSE(PredictLow(i),0),bit);
+    Update(bit);
+    UpdateSSE(bit,0);
+
+    bit=uh[i];
+    rc.EncodeBitOne(PredictSSE(PredictHigh(i),0),bit);
+    Update(bit);
+    UpdateSSE(bit,0);
+  }
+}
+
+template <class tcoder>
+void MapEncoder::Decode(tcoder &rc)
+{
+  for (int i=1;i<=1<<15;i++) {
+    int bit=rc.DecodeBitOne(PredictSSE(PredictLow(i),0));
+    Update(bit);
+    ul[i]=bit;
+    UpdateSSE(bit,0);
+
+    bit=rc.DecodeBitOne(PredictSSE(PredictHigh(i),0));
+    Update(bit);
+    uh[i]=bit;
+    UpdateSSE(bit,0);
+  }
+}
+
 class Remap {
   public:
     Remap();
@@ -0,0 +1,180 @@
+#ifndef PCM32_H
+#define PCM32_H
+
+#include "../model/counter.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// lossless split of 32 bit int and ieee float pcm into an integer part of
+// at most 24 bit, which runs through the normal predictor, and an exact
+// residual coded here. Split replaces buf[i] by the integer part,
+// Merge gets the integer part back and restores the input bits
+class PCM32Coder {
+  const int cnt_upd_rate=250;
+  public:
+    enum Format {INT32,FLOAT32};
+    explicit PCM32Coder(Format fmt)
+    :fmt(fmt),clow(256),cfrac(24*24)
+    {
+    }
+    template <class tcoder> void Split(tcoder &rc,int32_t *buf,int numsamples);
+    template <class tcoder> void Merge(tcoder &rc,int32_t *buf,int numsamples);
+  private:
+    template <class tcoder> void EncodeBits(tcoder &rc,uint32_t val,int nbits,LinearCounterLimit *ctx,bool tree);
+    template <class tcoder> uint32_t DecodeBits(tcoder &rc,int nbits,LinearCounterLimit *ctx,bool tree);
+    template <class tcoder> void EncodeRaw(tcoder &rc,uint32_t val,int nbits)
+    {
+      for (int i=nbits-1;i>=0;i--) rc.EncodeBitOne(PSCALEh,(val>>i)&1);
+    }
+    template <class tcoder> uint32_t DecodeRaw(tcoder &rc,int nbits)
+    {
+      uint32_t val=0;
+      for (int i=0;i<nbits;i++) val=(val<<1)+rc.DecodeBitOne(PSCALEh);
+      return val;
+    }
+    static int BitLength(uint32_t val)
+    {
+      int n=0;
+      while (val) {val>>=1;n++;};
+      return n;
+    }
+    static float AsFloat(uint32_t u) {float x;std::memcpy(&x,&u,4);return x;};
+    static uint32_t AsBits(float x) {uint32_t u;std::memcpy(&u,&x,4);return u;};
+    static bool IsFinite(uint32_t u) {return ((u>>23)&0xff)!=0xff;};
+    static int32_t FloatToInt(uint32_t u,int s) // trunc(x*2^s), 0 for nan/inf
+    {
+      if (!IsFinite(u)) return 0;
+      return static_cast<int32_t>(std::trunc(std::ldexp(static_cast<double>(AsFloat(u)),s)));
+    }
+
+    Format fmt;
+    std::vector <LinearCounterLimit> clow,cfrac; // int32 low byte tree, float fraction bits by (#bits,pos)
+    LinearCounterLimit czero; // float escape: +0.0 or raw
+};
+
+// tree: context is the binary tree node of the bits seen so far (nbits<=8),
+// else the bit position
+template <class tcoder>
+void PCM32Coder::EncodeBits(tcoder &rc,uint32_t val,int nbits,LinearCounterLimit *ctx,bool tree)
+{
+  int node=1;
+  for (int i=nbits-1;i>=0;i--) {
+    const int bit=(val>>i)&1;
+    LinearCounterLimit &c=ctx[tree?node:i];
+    rc.EncodeBitOne(c.p1,bit);
+    c.update(bit,cnt_upd_rate);
+    node+=node+bit;
+  }
+}
+
+template <class tcoder>
+uint32_t PCM32Coder::DecodeBits(tcoder &rc,int nbits,LinearCounterLimit *ctx,bool tree)
+{
+  int node=1;
+  uint32_t val=0;
+  for (int i=nbits-1;i>=0;i--) {
+    LinearCounterLimit &c=ctx[tree?node:i];
+    const int bit=rc.DecodeBitOne(c.p1);
+    c.update(bit,cnt_upd_rate);
+    node+=node+bit;
+    val=(val<<1)+bit;
+  }
+  return val;
+}
+
+// int32: v=(hi<<shift)+(lo<<w), w=common trailing zeros, shift=max(w,8)
+// float: scaled by 2^(23-e) with |x|<2^e over the block, the integer part
+// has L bits and the fraction the remaining 24-L mantissa bits, common
+// trailing zeros of the integer part (e.g. from 16 bit sources) are dropped.
+// An integer part of 0 escapes: +0.0 or the raw 32 bits (denormals, nan, inf..)
+template <class tcoder>
+void PCM32Coder::Split(tcoder &rc,int32_t *buf,int numsamples)
+{
+  if (fmt==INT32) {
+    uint32_t vor=0;
+    for (int i=0;i<numsamples;i++) vor|=static_cast<uint32_t>(buf[i]);
+    int w=0;
+    if (vor==0) w=8;
+    else while (((vor>>w)&1)==0) w++;
+    const int shift=std::max(w,8);
+    const int nlow=shift-w;
+    EncodeRaw(rc,w,5);
+    for (int i=0;i<numsamples;i++) {
+      const int32_t v=buf[i];
+      if (nlow) EncodeBits(rc,(static_cast<uint32_t>(v)>>w)&((1u<<nlow)-1),nlow,&clow[0],true);
+      buf[i]=v>>shift;
+    }
+  } else {
+    float vmax=0.0f;
+    for (int i=0;i<numsamples;i++) {
+      const uint32_t u=static_cast<uint32_t>(buf[i]);
+      if (IsFinite(u)) vmax=std::max(vmax,std::fabs(AsFloat(u)));
+    }
+    int e=0;
+    if (vmax>0.0f) std::frexp(vmax,&e);
+    EncodeRaw(rc,e+160,9);
+    const int s=23-e;
+    uint32_t vor=0;
+    for (int i=0;i<numsamples;i++) vor|=static_cast<uint32_t>(FloatToInt(static_cast<uint32_t>(buf[i]),s));
+    int w=0;
+    if (vor) while (((vor>>w)&1)==0) w++;
+    EncodeRaw(rc,w,5);
+    for (int i=0;i<numsamples;i++) {
+      const uint32_t u=static_cast<uint32_t>(buf[i]);
+      const int32_t ival=FloatToInt(u,s);
+      if (ival==0) {
+        const int zero=(u==0);
+        rc.EncodeBitOne(czero.p1,zero);
+        czero.update(zero,cnt_upd_rate);
+        if (!zero) EncodeRaw(rc,u,32);
+      } else {
+        const uint32_t ai=static_cast<uint32_t>(std::abs(ival));
+        const int nfrac=24-BitLength(ai);
+        const double d=std::ldexp(static_cast<double>(std::fabs(AsFloat(u))),s);
+        const uint32_t frac=static_cast<uint32_t>(std::ldexp(d-ai,nfrac));
+        EncodeBits(rc,frac,nfrac,&cfrac[nfrac*24],false);
+      }
+      buf[i]=ival>>w;
+    }
+  }
+}
+
+template <class tcoder>
+void PCM32Coder::Merge(tcoder &rc,int32_t *buf,int numsamples)
+{
+  if (fmt==INT32) {
+    const int w=DecodeRaw(rc,5);
+    const int shift=std::max(w,8);
+    const int nlow=shift-w;
+    for (int i=0;i<numsamples;i++) {
+      uint32_t v=static_cast<uint32_t>(buf[i])<<shift;
+      if (nlow) v|=DecodeBits(rc,nlow,&clow[0],true)<<w;
+      buf[i]=static_cast<int32_t>(v);
+    }
+  } else {
+    const int e=static_cast<int>(DecodeRaw(rc,9))-160;
+    const int s=23-e;
+    const int w=DecodeRaw(rc,5);
+    for (int i=0;i<numsamples;i++) {
+      const int32_t ival=static_cast<int32_t>(static_cast<uint32_t>(buf[i])<<w);
+      uint32_t u;
+      if (ival==0) {
+        const int zero=rc.DecodeBitOne(czero.p1);
+        czero.update(zero,cnt_upd_rate);
+        u=zero?0:DecodeRaw(rc,32);
+      } else {
+        const uint32_t ai=static_cast<uint32_t>(std::abs(ival));
+        const int nfrac=24-BitLength(ai);
+        const uint32_t frac=DecodeBits(rc,nfrac,&cfrac[nfrac*24],false);
+        const double d=ai+std::ldexp(static_cast<double>(frac),-nfrac);
+        u=AsBits(static_cast<float>(std::ldexp(ival<0?-d:d,-s)));
+      }
+      buf[i]=static_cast<int32_t>(u);
+    }
+  }
+}
+
+#endif // PCM32_H
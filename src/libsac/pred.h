@@ -9,7 +9,7 @@
 class Predictor {
   public:
     struct tparam {
-      int nA,nB,nM0,nS0,nS1,k;
+      int nA,nB,nM0,nS0,nS1,k,ols_solver;
       std::vector <int>vn0,vn1;
       std::vector <double>vmu0,vmu1;
       std::vector <double>vmudecay0,vmudecay1;
@@ -20,6 +20,7 @@ class Predictor {
       int ch_ref;
       double bias_mu0,bias_mu1;
       int bias_scale0,bias_scale1;
+      const SIMD::tkernels *kernels=SIMD::kernels; // SIMD::Legacy() for 'SAC2' streams
     };
     explicit Predictor(const tparam &p);
 
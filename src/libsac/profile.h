@@ -92,7 +92,7 @@ class SacProfile {
       {
 
       }
-      int LoadBaseProfile();
+      int LoadBaseProfile(int ols_solver=0);
       std::size_t get_size() {return coefs.size();};
       void Set(int num,double vmin,double vmax,double vdef)
       {
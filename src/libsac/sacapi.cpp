@@ -0,0 +1,89 @@
+#include "sacapi.h"
+#include "libsac.h"
+#include <algorithm>
+
+struct sac_encoder {
+  sac_encoder(int numchannels,int framesize,const FrameCoder::coder_ctx &opt)
+  :coder(numchannels,framesize,opt),numchannels(numchannels),framesize(framesize) {};
+  FrameCoder coder;
+  int numchannels,framesize;
+};
+
+struct sac_decoder {
+  sac_decoder(int numchannels,int framesize,const FrameCoder::coder_ctx &opt)
+  :coder(numchannels,framesize,opt),numchannels(numchannels),framesize(framesize) {};
+  FrameCoder coder;
+  int numchannels,framesize;
+};
+
+static int GetFrameSize(int framesize,int samplerate)
+{
+  if (framesize>0) return framesize;
+  FrameCoder::coder_ctx opt;
+  return opt.max_framelen*samplerate;
+}
+
+sac_encoder *sac_encoder_create(const sac_encoder_cfg &cfg)
+{
+  const int framesize=GetFrameSize(cfg.framesize,cfg.samplerate);
+  if (cfg.numchannels<1 || cfg.numchannels>FrameCoder::max_channels || framesize<=0) return nullptr;
+
+  FrameCoder::coder_ctx opt;
+  opt.SetPreset(cfg.preset);
+  opt.sparse_pcm=cfg.sparse_pcm;
+  opt.zero_mean=cfg.zero_mean;
+  opt.mt_mode=cfg.mt_mode;
+  opt.ols_solver=cfg.ols_solver;
+  opt.ConfigureOpt();
+  return new sac_encoder(cfg.numchannels,framesize,opt);
+}
+
+void sac_encoder_destroy(sac_encoder *enc)
+{
+  delete enc;
+}
+
+int64_t sac_encode_frame(sac_encoder *enc,const int32_t * const *planes,int n,std::vector<uint8_t> &out_buf)
+{
+  if (enc==nullptr || planes==nullptr || n<=0 || n>enc->framesize) return -1;
+
+  FrameCoder &coder=enc->coder;
+  for (int ch=0;ch<enc->numchannels;ch++)
+    std::copy_n(planes[ch],n,&coder.samples[ch][0]);
+  coder.SetNumSamples(n);
+  coder.Predict();
+  coder.Encode();
+  return static_cast<int64_t>(coder.PackEncoded(out_buf));
+}
+
+sac_decoder *sac_decoder_create(const sac_decoder_cfg &cfg)
+{
+  const int framesize=GetFrameSize(cfg.framesize,cfg.samplerate);
+  if (cfg.numchannels<1 || cfg.numchannels>FrameCoder::max_channels || framesize<=0) return nullptr;
+
+  FrameCoder::coder_ctx opt;
+  opt.mt_mode=cfg.mt_mode;
+  return new sac_decoder(cfg.numchannels,framesize,opt);
+}
+
+void sac_decoder_destroy(sac_decoder *dec)
+{
+  delete dec;
+}
+
+int64_t sac_decode_frame(sac_decoder *dec,const uint8_t *buf,std::size_t len,int32_t * const *planes,int &n)
+{
+  n=0;
+  if (dec==nullptr || buf==nullptr || planes==nullptr) return -1;
+
+  FrameCoder &coder=dec->coder;
+  const std::size_t consumed=coder.UnpackEncoded(buf,len);
+  if (consumed==0) return -1;
+  coder.Decode();
+  coder.Unpredict();
+
+  n=coder.GetNumSamples();
+  for (int ch=0;ch<dec->numchannels;ch++)
+    std::copy_n(&coder.samples[ch][0],n,planes[ch]);
+  return static_cast<int64_t>(consumed);
+}
@@ -0,0 +1,49 @@
+#ifndef SACAPI_H
+#define SACAPI_H
+
+// in-memory frame api, no file i/o
+// one call codes one frame, the bytes are laid out exactly as a frame
+// inside a .sac file. Containers, md5 and framing are up to the caller.
+// Frames carry no crc, streams written with --frame-crc are not supported
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+struct sac_encoder;
+struct sac_decoder;
+
+struct sac_encoder_cfg {
+  int numchannels=2;
+  int samplerate=44100;
+  int framesize=0;  // max samples per frame, def=20 seconds
+  int preset=0;     // 0=normal,1=high,2=veryhigh,3=extrahigh,4=best,5=insane
+  int sparse_pcm=1;
+  int zero_mean=1;
+  int mt_mode=2;
+  int ols_solver=0; // 0=cholesky,1=rank-1 update, decoder reads it from the frame
+};
+
+struct sac_decoder_cfg {
+  int numchannels=2;
+  int samplerate=44100;
+  int framesize=0;  // must cover the largest frame of the stream
+  int mt_mode=2;
+};
+
+// returns nullptr on an invalid cfg
+sac_encoder *sac_encoder_create(const sac_encoder_cfg &cfg);
+void sac_encoder_destroy(sac_encoder *enc);
+
+// codes n samples of planes[ch][0..n-1] into out_buf (resized)
+// returns the frame size in bytes or <0 on error
+int64_t sac_encode_frame(sac_encoder *enc,const int32_t * const *planes,int n,std::vector<uint8_t> &out_buf);
+
+sac_decoder *sac_decoder_create(const sac_decoder_cfg &cfg);
+void sac_decoder_destroy(sac_decoder *dec);
+
+// decodes the frame at buf into planes[ch][0..n-1], planes must hold framesize samples
+// returns the number of bytes consumed or <0 on error
+int64_t sac_decode_frame(sac_decoder *dec,const uint8_t *buf,std::size_t len,int32_t * const *planes,int &n);
+
+#endif // SACAPI_H
@@ -1,15 +1,51 @@
 #include "vle.h"
 
+// tables are sized to the largest context they can see
 BitplaneCoder::BitplaneCoder(int maxbpn,int numsamples)
-:csig0(1<<20),csig1(1<<20),csig2(1<<20),csig3(1<<20),
-cref0(1<<20),cref1(1<<20),cref2(1<<20),cref3(1<<20),
+:csig0(1<<16), // 16 neighbour significance bits
+csig1(2*nwin_sig+1), // #msb>bpn in the window
+cref0(32), // msb
+cref1(256), // ctx1&255
+cref2(64), // 6 bit ctx2
+cref3(8*31+1), // sum of 8 neighbour msb
 p_laplace(32),
-lmixref(256,NMixLogistic(5)),lmixsig(256,NMixLogistic(3)),
-ssemix(2),
-msb(numsamples),
-maxbpn(maxbpn),numsamples(numsamples),lm(maxbpn)
+lmixref(32,NMixLogistic(5)),lmixsig(128,NMixLogistic(3)),
+ssemix(2)
 //n_laplace(32),weights_laplace(2*n_laplace+1),
 {
+  for (int i=0;i<32;i++) {
+    bmask[i]=~((1<<i)-1);
+  }
+  Init(maxbpn,numsamples);
+  /*double s=35;
+  for (int i=0;i<2*n_laplace+1;i++) {
+    int idx=i-n_laplace;
+    weights_laplace[i]=1.0; //exp(-(idx*idx)/(s*s));
+  }*/
+}
+
+// bring every model back to its freshly constructed state,
+// keeps the allocations
+void BitplaneCoder::Reset(int maxbpn,int numsamples)
+{
+  static const SSENL<15> sse0;
+  for (auto *tbl:{&csig0,&csig1,&cref0,&cref1,&cref2,&cref3})
+    std::fill(tbl->begin(),tbl->end(),LinearCounterLimit());
+  for (auto &mix:lmixref) mix.Init(0);
+  for (auto &mix:lmixsig) mix.Init(0);
+  ssemix.Init(0);
+  std::fill(std::begin(sse),std::end(sse),sse0);
+  Init(maxbpn,numsamples);
+}
+
+void BitplaneCoder::Init(int maxbpn,int numsamples)
+{
+  this->maxbpn=maxbpn;
+  this->numsamples=numsamples;
+  abuf_pad.assign(numsamples+2*npad,0);
+  msb_pad.assign(numsamples+2*npad,0);
+  pabuf=&abuf_pad[npad];
+  msb=&msb_pad[npad];
   state=0;
   bpn=0;
   nrun=0;
@@ -17,38 +53,19 @@ maxbpn(maxbpn),numsamples(numsamples),lm(maxbpn)
   for (int i=0;i<32;i++) {
     int p=(std::min)((std::max)((int)round((1.0-1.0/(1+pow(theta,1<<i)))*PSCALE),1),PSCALEm);
     //std::cout << p << ' ';
+    p_laplace[i]=LinearCounterLimit();
     p_laplace[i].p1=p;
   }
   pestimate=0;
-  for (int i=0;i<32;i++) {
-    bmask[i]=~((1<<i)-1);
-  }
-  /*double s=35;
-  for (int i=0;i<2*n_laplace+1;i++) {
-    int idx=i-n_laplace;
-    weights_laplace[i]=1.0; //exp(-(idx*idx)/(s*s));
-  }*/
 }
 
 void BitplaneCoder::GetSigState(int i)
 {
   sigst[0]=msb[i];
-  sigst[1]=i>0?msb[i-1]:0;
-  sigst[2]=i<numsamples-1?msb[i+1]:0;
-  sigst[3]=i>1?msb[i-2]:0;
-  sigst[4]=i<numsamples-2?msb[i+2]:0;
-  sigst[5]=i>2?msb[i-3]:0;
-  sigst[6]=i<numsamples-3?msb[i+3]:0;
-  sigst[7]=i>3?msb[i-4]:0;
-  sigst[8]=i<numsamples-4?msb[i+4]:0;
-  sigst[9]=i>4?msb[i-5]:0;
-  sigst[10]=i<numsamples-5?msb[i+5]:0;
-  sigst[11]=i>5?msb[i-6]:0;
-  sigst[12]=i<numsamples-6?msb[i+6]:0;
-  sigst[13]=i>6?msb[i-7]:0;
-  sigst[14]=i<numsamples-7?msb[i+7]:0;
-  sigst[15]=i>7?msb[i-8]:0;
-  sigst[16]=i<numsamples-8?msb[i+8]:0;
+  for (int k=1;k<=8;k++) {
+    sigst[2*k-1]=msb[i-k];
+    sigst[2*k]=msb[i+k];
+  }
 }
 
 static inline uint32_t ilog2(const uint32_t x) {
@@ -60,20 +77,38 @@ static inline uint32_t ilog2(const uint32_t x) {
   return y;
 }
 
-uint32_t BitplaneCoder::GetAvgSum(int n)
+void BitplaneCoder::InitContext()
 {
-  uint64_t nsum=0;
-  int nidx=0;
-
-  for (int k=sample-n;k<=sample+n;k++) {
-    if (k>=0 && k<numsamples) {
-      int val=pabuf[k];
-      val&=k<sample?bmask[bpn]:bmask[bpn+1];
-      nsum+=val;
-      nidx++;
-    }
+  win_sum=0;
+  for (int k=0;k<=nwin_avg;k++) win_sum+=pabuf[k]&bmask[bpn+1];
+
+  // the scan to the right stops before the last sample
+  win_n1=win_n2=0;
+  for (int k=1;k<=nwin_sig;k++) {
+    const int in=k<numsamples-1;
+    win_n1+=in&(msb[k]!=0);
+    win_n2+=in&(msb[k]>bpn);
   }
-  return nidx>0?(nsum+(nidx-1))/nidx:0;
+}
+
+void BitplaneCoder::NextContext()
+{
+  const int i=sample;
+  // sample i now counts with bits>=bpn, i-nwin leaves, i+nwin+1 enters
+  win_sum+=pabuf[i]&(1u<<bpn);
+  win_sum-=pabuf[i-nwin_avg]&bmask[bpn];
+  win_sum+=pabuf[i+nwin_avg+1]&bmask[bpn+1];
+
+  const int in_r0=(i+1)<numsamples-1;
+  const int in_r1=(i+nwin_sig+1)<numsamples-1;
+  win_n1+=(msb[i]!=0)-(msb[i-nwin_sig]!=0)-(in_r0&(msb[i+1]!=0))+(in_r1&(msb[i+nwin_sig+1]!=0));
+  win_n2+=(msb[i]>bpn)-(msb[i-nwin_sig]>bpn)-(in_r0&(msb[i+1]>bpn))+(in_r1&(msb[i+nwin_sig+1]>bpn));
+}
+
+uint32_t BitplaneCoder::GetAvgSum()
+{
+  const int nidx=std::min(sample+nwin_avg,numsamples-1)-std::max(sample-nwin_avg,0)+1;
+  return (win_sum+(nidx-1))/nidx;
 }
 
 int BitplaneCoder::PredictLaplace(uint32_t avg_sum)
@@ -91,10 +126,10 @@ int BitplaneCoder::PredictRef()
 {
   int val=pabuf[sample];
 
-  int lval=sample>0?pabuf[sample-1]:0;
-  int lval2=sample>1?pabuf[sample-2]:0;
-  int nval=sample<(numsamples-1)?pabuf[sample+1]:0;
-  int nval2=sample<(numsamples-2)?pabuf[sample+2]:0;
+  int lval=pabuf[sample-1];
+  int lval2=pabuf[sample-2];
+  int nval=pabuf[sample+1];
+  int nval2=pabuf[sample+2];
 
   int b0=(val>>(bpn+1));
   int b1=(lval>>(bpn));
@@ -149,30 +184,14 @@ void BitplaneCoder::UpdateRef(int bit)
   state=(state<<1)+0;
 }
 
-// count number of significant samples in neighborhood
-void BitplaneCoder::CountSig(int n,int &n1,int &n2)
-{
-  n1=n2=0;
-  for (int i=1;i<=n;i++) {
-    if (sample-i>=0) {
-       if (msb[sample-i]) n1+=1;
-       if (msb[sample-i]>bpn) n2+=1;
-    }
-    if (sample+i<numsamples-1) {
-       if (msb[sample+i]) n1+=1;
-       if (msb[sample+i]>bpn) n2+=1;
-    }
-  }
-}
-
 int BitplaneCoder::PredictSig()
 {
   int ctx1=0;
   for (int i=0;i<16;i++)
-    if (sigst[i+1]) ctx1+=1<<i;
+    ctx1+=(sigst[i+1]!=0)<<i;
 
-  int n1,n2;
-  CountSig(32,n1,n2);
+  const int n1=win_n1;
+  const int n2=win_n2;
   int ctx2=n2;
 
   pl=&p_laplace[bpn];
@@ -212,60 +231,3 @@ void BitplaneCoder::UpdateSSE(int bit)
   ssemix.Update(bit,mixsse_upd_rate);
 }
 
-void BitplaneCoder::Encode(EncodeP1 encode_p1,int32_t *abuf)
-{
-  pabuf=abuf;
-  for (bpn=maxbpn;bpn>=0;bpn--)  {
-    state=0;
-    for (sample=0;sample<numsamples;sample++) {
-      uint32_t avg_sum = GetAvgSum(32);
-      pestimate=PredictLaplace(avg_sum);//lm.Predict(avg_sum,bpn);
-      GetSigState(sample);
-      int bit=(pabuf[sample]>>bpn)&1;
-      int p=0;
-      if (sigst[0]) { // coef is significant, refine
-        p=PredictSSE(PredictRef());
-        encode_p1(p,bit);
-        UpdateRef(bit);
-        UpdateSSE(bit);
-      } else { // coef is insignificant
-        p=PredictSSE(PredictSig());
-        encode_p1(p,bit);
-        UpdateSig(bit);
-        UpdateSSE(bit);
-        if (bit) msb[sample]=bpn;
-      }
-    }
-  }
-}
-
-void BitplaneCoder::Decode(DecodeP1 decode_p1,int32_t *buf)
-{
-  int bit;
-  pabuf=buf;
-  for (int i=0;i<numsamples;i++) buf[i]=0;
-  for (bpn=maxbpn;bpn>=0;bpn--)  {
-    state=0;
-    for (sample=0;sample<numsamples;sample++) {
-      uint32_t avg_sum=GetAvgSum(32);
-      pestimate=PredictLaplace(avg_sum);//lm.Predict(avg_sum,bpn);
-      GetSigState(sample);
-      if (sigst[0]) { // coef is significant, refine
-        bit=decode_p1(PredictSSE(PredictRef()));
-        UpdateRef(bit);
-        UpdateSSE(bit);
-        if (bit) buf[sample]+=(1<<bpn);
-       } else { // coef is insignificant
-         bit=decode_p1(PredictSSE(PredictSig()));
-         UpdateSig(bit);
-         UpdateSSE(bit);
-         if (bit) {
-           buf[sample]+=(1<<bpn);
-           msb[sample]=bpn;
-          }
-        }
-    }
-  }
-  for (int i=0;i<numsamples;i++) buf[i]=MathUtils::U2S(buf[i]);
-}
-
@@ -6,7 +6,6 @@
 #include "../model/sse.h"
 #include "../model/mixer.h"
 #include "../common/utils.h"
-#include <functional>
 
 //#define h1y(v,k) (((v)>>k)^(v))
 //#define h2y(v,k) (((v)*2654435761UL)>>(k))
@@ -36,8 +35,10 @@ class StaticLaplaceModel {
     std::vector<std::vector<int>> pr;
 };
 
-using EncodeP1 = std::function<void(uint32_t,int)>;
-using DecodeP1 = std::function<int(uint32_t)>;
+// default for BitplaneCoder::Encode, never stops
+struct NoAbort {
+  bool operator()() const {return false;};
+};
 
 class BitplaneCoder {
   const int cnt_upd_rate_p=150;
@@ -47,12 +48,23 @@ class BitplaneCoder {
   const int mix_upd_rate_sig=700;
   const int cntsse_upd_rate=250;
   const int mixsse_upd_rate=250;
+  static const int nwin_avg=32; // +-neighbours for the average magnitude
+  static const int nwin_sig=32; // +-neighbours for the significance counts
+  static const int npad=nwin_avg+1; // zeros around pabuf/msb, no bounds checks
   public:
     BitplaneCoder(int maxbpn,int numsamples);
-    void Encode(EncodeP1 encode_p1,int32_t *abuf);
-    void Decode(DecodeP1 decode_p1,int32_t *buf);
+    BitplaneCoder(const BitplaneCoder &)=delete; // pabuf/msb point into the own buffers
+    BitplaneCoder(BitplaneCoder &&)=default;
+    void Reset(int maxbpn,int numsamples); // reuse for another block
+    // tcoder provides EncodeBitOne(p1,bit) resp. DecodeBitOne(p1),
+    // resolved at compile time so the per-bit call can be inlined.
+    // Encode polls abort() every 256 samples, returns false if it stopped
+    template <class tcoder,class tabort=NoAbort> bool Encode(tcoder &rc,int32_t *abuf,tabort abort=tabort());
+    template <class tcoder> void Decode(tcoder &rc,int32_t *buf);
   private:
-    void CountSig(int n,int &n1,int &n2);
+    void Init(int maxbpn,int numsamples);
+    void InitContext(); // window sums at sample 0 of a bitplane
+    void NextContext(); // slide the windows from sample to sample+1
     void GetSigState(int i); // get actual significance state
     int PredictLaplace(uint32_t avg_sum);
     int PredictRef();
@@ -61,29 +73,95 @@ class BitplaneCoder {
     void UpdateSig(int bit);
     int PredictSSE(int p1);
     void UpdateSSE(int bit);
-    uint32_t GetAvgSum(int n);
+    uint32_t GetAvgSum();
 
-    std::vector<LinearCounterLimit> csig0,csig1,csig2,csig3,cref0,cref1,cref2,cref3;
+    std::vector<LinearCounterLimit> csig0,csig1,cref0,cref1,cref2,cref3;
     std::vector<LinearCounterLimit>p_laplace;
     std::vector <NMixLogistic>lmixref,lmixsig;
     NMixLogistic ssemix;
 
-    SSENL<15> sse[1<<12];
+    SSENL<15> sse[32+128]; // pestimate x sig | 7 sig bits
     SSENL<15> *psse1,*psse2;
     LinearCounterLimit *pc1,*pc2,*pc3,*pc4;
     LinearCounterLimit *pl;
     NMixLogistic *plmix;
-    int *pabuf,sample;
-    std::vector <int>msb;
+    std::vector <int>abuf_pad,msb_pad;
+    int *pabuf,*msb,sample;
+    uint64_t win_sum; // sum over sample+-nwin_avg, bits>=bpn left, >bpn from sample on
+    int win_n1,win_n2; // #msb!=0 and #msb>bpn over sample+-nwin_sig, excluding sample
     //int n_laplace;
     //std::vector <double>weights_laplace;
     int sigst[17];
     uint32_t bmask[32];
     int maxbpn,bpn,numsamples,nrun,pestimate;
     uint32_t state;
-    StaticLaplaceModel lm;
 };
 
+template <class tcoder,class tabort>
+bool BitplaneCoder::Encode(tcoder &rc,int32_t *abuf,tabort abort)
+{
+  std::copy_n(abuf,numsamples,pabuf);
+  for (bpn=maxbpn;bpn>=0;bpn--)  {
+    state=0;
+    sample=0;
+    InitContext();
+    for (;sample<numsamples;sample++) {
+      uint32_t avg_sum = GetAvgSum();
+      pestimate=PredictLaplace(avg_sum);//lm.Predict(avg_sum,bpn);
+      GetSigState(sample);
+      int bit=(pabuf[sample]>>bpn)&1;
+      int p=0;
+      if (sigst[0]) { // coef is significant, refine
+        p=PredictSSE(PredictRef());
+        rc.EncodeBitOne(p,bit);
+        UpdateRef(bit);
+        UpdateSSE(bit);
+      } else { // coef is insignificant
+        p=PredictSSE(PredictSig());
+        rc.EncodeBitOne(p,bit);
+        UpdateSig(bit);
+        UpdateSSE(bit);
+        if (bit) msb[sample]=bpn;
+      }
+      NextContext();
+      if ((sample&255)==255 && abort()) return false;
+    }
+  }
+  return true;
+}
+
+template <class tcoder>
+void BitplaneCoder::Decode(tcoder &rc,int32_t *buf)
+{
+  int bit;
+  for (bpn=maxbpn;bpn>=0;bpn--)  {
+    state=0;
+    sample=0;
+    InitContext();
+    for (;sample<numsamples;sample++) {
+      uint32_t avg_sum=GetAvgSum();
+      pestimate=PredictLaplace(avg_sum);//lm.Predict(avg_sum,bpn);
+      GetSigState(sample);
+      if (sigst[0]) { // coef is significant, refine
+        bit=rc.DecodeBitOne(PredictSSE(PredictRef()));
+        UpdateRef(bit);
+        UpdateSSE(bit);
+        if (bit) pabuf[sample]+=(1<<bpn);
+       } else { // coef is insignificant
+         bit=rc.DecodeBitOne(PredictSSE(PredictSig()));
+         UpdateSig(bit);
+         UpdateSSE(bit);
+         if (bit) {
+           pabuf[sample]+=(1<<bpn);
+           msb[sample]=bpn;
+          }
+        }
+      NextContext();
+    }
+  }
+  for (int i=0;i<numsamples;i++) buf[i]=MathUtils::U2S(pabuf[i]);
+}
+
 class Golomb {
   public:
     Golomb (RangeCoderSH &rc)
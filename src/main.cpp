@@ -1,5 +1,6 @@
 #include "cmdline.h"
 #include "opt/opt.h"
+#include "common/simd.h"
 //#include <cfenv>
 
 #define SAC_VERSION "0.7.18"
@@ -9,6 +10,10 @@ int main(int argc,char *argv[])
 
   //std::fesetround(FE_TONEAREST);
 
+  // audio data goes to stdout, so all messages are routed to stderr
+  std::streambuf *stdout_buf=std::cout.rdbuf();
+  if (CmdLine::OutputIsStdout(argc,argv)) std::cout.rdbuf(std::cerr.rdbuf());
+
   std::cout << "Sac v" << SAC_VERSION << " - Lossless Audio Coder (c) Sebastian Lehmann\n";
   std::cout << "compiled on " << __DATE__ << " ";
   #ifdef __x86_64
@@ -16,10 +21,7 @@ int main(int argc,char *argv[])
   #else
     std::cout << "(32-bit";
   #endif
-  #if defined(USE_AVX256)
-    std::cout << ",AVX2";
-  #endif
-  std::cout << ")";
+  std::cout << "," << CPUInfo::Name(SIMD::kernels->level) << ")";
   #ifdef __clang__
     std::cout << " clang " << __clang_major__ << "." << __clang_minor__ << "." << __clang_patchlevel__ << "\n";
   #elif __GNUC__ // __clang__
@@ -27,7 +29,7 @@ int main(int argc,char *argv[])
   #endif
   std::cout << "\n\n";
 
-  CmdLine cmdline;
+  CmdLine cmdline(stdout_buf);
   int error=cmdline.Parse(argc,argv);
   if (error==0) error=cmdline.Process();
   return error;
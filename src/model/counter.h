@@ -2,6 +2,7 @@
 #define COUNTER_H
 
 #include "model.h"
+#include <cstdint>
 
 class Prob16Counter
 {
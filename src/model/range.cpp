@@ -63,22 +63,6 @@ void RangeCoderSH::Stop()
   if (decode==0) DO(NUM+1) ShiftLow();
 }
 
-void RangeCoderSH::EncodeBitOne(uint32_t p1,int bit)
-{
-  const uint32_t rnew=SCALE_RANGE;
-  bit ? range-=rnew, lowc+=rnew : range=rnew;
-  while(range<TOP) range<<=8,ShiftLow();
-}
-
-int RangeCoderSH::DecodeBitOne(uint32_t p1)
-{
-  const uint32_t rnew=SCALE_RANGE;
-  int bit = (code>=rnew);
-  bit ? range-=rnew, code-=rnew : range=rnew;
-  while(range<TOP) range<<=8,(code<<=8)+=buf.GetByte();
-  return bit;
-}
-
 void RangeCoderSH::ShiftLow()
 {
   uint32_t Carry = uint32_t(lowc>>32), low = uint32_t(lowc);
@@ -3,7 +3,6 @@
 
 #include "../common/bufio.h"
 #include "model.h"
-#include <functional>
 
 class RangeCoderBase {
   public:
@@ -48,11 +47,21 @@ class RangeCoderSH : public RangeCoderBase {
     using RangeCoderBase::RangeCoderBase;
     void Init();
     void Stop();
-    void EncodeBitOne(uint32_t p1,int bit);
-    int  DecodeBitOne(uint32_t p1);
-
-    std::function<void(uint32_t,int)> encode_p1 = [this](uint32_t p1,int bit) {return EncodeBitOne(p1,bit);}; // stupid C++
-    std::function<int(uint32_t)> decode_p1 = [this](uint32_t p1) {return DecodeBitOne(p1);};
+    // inline, called once per coded bit from the templated models
+    inline void EncodeBitOne(uint32_t p1,int bit)
+    {
+      const uint32_t rnew=SCALE_RANGE;
+      bit ? range-=rnew, lowc+=rnew : range=rnew;
+      while(range<TOP) range<<=8,ShiftLow();
+    }
+    inline int DecodeBitOne(uint32_t p1)
+    {
+      const uint32_t rnew=SCALE_RANGE;
+      int bit = (code>=rnew);
+      bit ? range-=rnew, code-=rnew : range=rnew;
+      while(range<TOP) range<<=8,(code<<=8)+=buf.GetByte();
+      return bit;
+    }
   protected:
     void ShiftLow();
     uint32_t range,code,FFNum,Cache;
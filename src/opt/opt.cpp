@@ -1,5 +1,5 @@
 #include "opt.h"
-#include <future>
+#include "../common/threadpool.h"
 
 Opt::Opt(const box_const &parambox)
 :rand(0),pb(parambox),ndim(parambox.size())
@@ -7,27 +7,16 @@ Opt::Opt(const box_const &parambox)
 
 };
 
-// evaluate span of points with ps.size() parallel threads
+// evaluate span of points in parallel on the shared pool
 std::size_t Opt::eval_points_mt(opt_func func,std::span<ppoint> ps)
 {
-  std::vector <std::future<double>> threads;
-  threads.reserve(ps.size());
-
-  for (std::size_t i=0;i<ps.size();i++) {
-    auto arg=ps[i].second;
-    threads.emplace_back(std::async(std::launch::async, [func, arg]() {
-      return func(arg);
-    }));
-  }
-
-  if (threads.size()!=ps.size())
-    std::cerr << "  warning: eval_points_mt: thread count too low\n";
-
   std::vector<double>r1(ps.size());
-  for (std::size_t i=0;i<threads.size();i++) {
-    r1[i]=threads[i].get();
+  ThreadPool::Shared().ParallelFor(ps.size(),[&](int i) {
+    r1[i]=func(ps[i].second);
+  });
+
+  for (std::size_t i=0;i<ps.size();i++)
     if (std::isnan(r1[i])) std::cerr << " warning: nan in eval_points_mt\n";
-  }
 
   // transfer savely to ps
   for (std::size_t i=0;i<ps.size();i++)
@@ -43,7 +32,7 @@ std::size_t Opt::eval_points_mt(opt_func func,std::span<ppoint> ps)
         std::cerr << "  warning: mt res (" << i << "): " << r1[i] << ' ' << r2[i] << '\n';
   #endif
 
-  return threads.size();
+  return ps.size();
 }
 
 vec1D Opt::scale(const vec1D &x) {
@@ -5,17 +5,19 @@
 #include "../global.h"
 #include "../common/histbuf.h"
 #include "../common/utils.h"
+#include "../common/simd.h"
 
 class LS_Stream {
   public:
-    LS_Stream(int n)
-    :n(n),x(n),w(n),pred(0.)
+    // x keeps one extra value: the sample that just left the window
+    LS_Stream(int n,const SIMD::tkernels *kernels=SIMD::kernels)
+    :n(n),x(n+1),w(n),pred(0.),kernels(kernels)
     {
 
     }
-    double Predict()
+    virtual double Predict()
     {
-      pred=MathUtils::dot(x.data(),w.data(),n);
+      pred=kernels->dot(x.data(),w.data(),n);
       return pred;
     }
     virtual void Update(double val)=0;
@@ -25,6 +27,7 @@ class LS_Stream {
     RollBuffer2<double>x;
     std::vector<double,align_alloc<double>> w;
     double pred;
+    const SIMD::tkernels *kernels;
 };
 
 /*
@@ -33,35 +36,15 @@ double r = pow(n, -pow_decay / double(n-1));
 for (int i = 1; i < n; i++) {
     powtab[i] = powtab[i-1] * r;
 }
-
-void update_w_avx(double* w, const double* mutab, const double* x, double wgrad, int n)
-{
-    __m256d wgrad_vec = _mm256_set1_pd(wgrad);
-    int i = 0;
-
-
-    for (; i <= n - 4; i += 4) {
-        __m256d w_vec = _mm256_loadu_pd(&w[i]);
-        __m256d mutab_vec = _mm256_loadu_pd(&mutab[i]);
-        __m256d x_vec = _mm256_loadu_pd(&x[i]);
-
-        __m256d wx = _mm256_mul_pd(wgrad_vec, x_vec);
-        __m256d result = _mm256_fmadd_pd(mutab_vec, wx, w_vec);
-        _mm256_storeu_pd(&w[i], result);
-    }
-
-    for (; i < n; ++i) {
-        w[i] += mutab[i] * (wgrad * x[i]);
-    }
-}*/
+*/
 
 
 class NLMS_Stream : public LS_Stream
 {
   const double eps_pow=1.0;
   public:
-    NLMS_Stream(int n,double mu,double mu_decay=1.0,double pow_decay=0.8)
-    :LS_Stream(n),mutab(n),powtab(n),mu(mu)
+    NLMS_Stream(int n,double mu,double mu_decay=1.0,double pow_decay=0.8,const SIMD::tkernels *kernels=SIMD::kernels)
+    :LS_Stream(n,kernels),mutab(n),powtab(n),mu(mu),spow(0.0)
     {
       sum_powtab=0;
       for (int i=0;i<n;i++) {
@@ -71,54 +54,23 @@ class NLMS_Stream : public LS_Stream
       }
     }
 
-  #if defined(USE_AVX256)
-    double calc_spow(const double *x,const double *powtab,std::size_t n)
-    {
-      double spow=0.0;
-      std::size_t i=0;
-      if (n>=4) {
-        __m256d sum_vec = _mm256_setzero_pd();
-        for (; i + 4 <= n; i += 4) {
-          __m256d x_vec = _mm256_loadu_pd(&x[i]);
-          __m256d pow_vec = _mm256_loadu_pd(&powtab[i]);
-          __m256d x_squared = _mm256_mul_pd(x_vec, x_vec);
-          sum_vec = _mm256_fmadd_pd(pow_vec, x_squared, sum_vec);
-        }
-
-        alignas(32) double buffer[4];
-        _mm256_storeu_pd(buffer, sum_vec);
-        spow = buffer[0] + buffer[1] + buffer[2] + buffer[3];
-      }
-
-      for (;i<n;i++)
-        spow += powtab[i] * (x[i] * x[i]);
-      return spow;
-    }
-  #else
-    double calc_spow(const double *x,const double *powtab,std::size_t n)
+    // pred and spow of the current input are left by the last Update
+    double Predict() override
     {
-      double spow=0.0;
-      for (std::size_t i=0;i<n;i++) {
-        spow+=powtab[i]*(x[i]*x[i]);
-      }
-      return spow;
+      return pred;
     }
-  #endif
 
     void Update(double val) override
     {
-      const double spow=calc_spow(x.data(),powtab.data(),n);
       const double wgrad=mu*(val-pred)*sum_powtab/(eps_pow+spow);
-      for (int i=0;i<n;i++) {
-        w[i]+=mutab[i]*(wgrad*x[i]);
-      }
       x.push(val);
+      pred=kernels->nlms_update(w.data(),x.data(),mutab.data(),powtab.data(),wgrad,n,spow);
     };
     ~NLMS_Stream(){};
   protected:
     std::vector<double,align_alloc<double>> mutab,powtab;
     double sum_powtab;
-    double mu;
+    double mu,spow;
 };
 
 class LADADA_Stream : public LS_Stream
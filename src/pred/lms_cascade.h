@@ -11,7 +11,7 @@
 
 class LMSCascade {
   public:
-    LMSCascade(const std::vector<int> &vn,const std::vector<double>&vmu,const std::vector<double>&vmudecay,const std::vector<double> &vpowdecay,double mu_mix,double mu_mix_beta)
+    LMSCascade(const std::vector<int> &vn,const std::vector<double>&vmu,const std::vector<double>&vmudecay,const std::vector<double> &vpowdecay,double mu_mix,double mu_mix_beta,const SIMD::tkernels *kernels=SIMD::kernels)
     :n(vn.size()),
     #ifdef LMS_N0
       p(n+1),lms_mix(n+1,mu_mix,mu_mix_beta),
@@ -25,11 +25,11 @@ class LMSCascade {
       #endif
       #ifdef LMS_ADA
         for (int i=0;i<n-1;i++)
-          clms[i]=new NLMS_Stream(vn[i],vmu[i],vmudecay[i],vpowdecay[i]);
+          clms[i]=new NLMS_Stream(vn[i],vmu[i],vmudecay[i],vpowdecay[i],kernels);
         clms[n-1]=new LMSADA_Stream(vn[n-1],vmu[n-1],vmudecay[n-1],vpowdecay[n-1]);
       #else
         for (int i=0;i<n;i++)
-          clms[i]=new NLMS_Stream(vn[i],vmu[i],vmudecay[i],vpowdecay[i]);
+          clms[i]=new NLMS_Stream(vn[i],vmu[i],vmudecay[i],vpowdecay[i],kernels);
       #endif
     }
     double Predict()
@@ -2,27 +2,55 @@
 #define LPC_H
 
 #include "../common/utils.h"
+#include "../common/alignbuf.h"
+#include "../common/simd.h"
 
 //#define INIT_COV
 
+// covariance and cholesky factor are packed lower-triangular matrices,
+// stored by column: column j holds rows j..n-1, padded to 8 doubles so
+// every column starts 64-byte aligned. Columns are contiguous, which lets
+// the rank-1 update and the factor/solve run over rows with simd.
+// All kernels keep the scalar operation order and use explicit fma, so
+// every simd level gives the same solution. 'SAC2' streams pass the
+// non-fused SIMD::Legacy() table instead
+//
+// solver CHOLESKY refactors the covariance every kmax samples, O(n^3)
+// solver UPDATE keeps the factor current with rank-1 updates, O(n^2):
+// L <- chol(lambda*L*L^T + c0*x*x^T), the ridge term nu is fed in one
+// diagonal element per sample, which holds it near nu*I in steady state
 class OLS {
+  typedef std::vector<double,align_alloc<double>> avec1D;
   public:
-    OLS(int n,int kmax=1,double lambda=0.998,double nu=0.001,double beta_sum=0.6,double beta_pow=0.75,double beta_add=2)
-    :x(n),
-    chol(n),
-    w(n),b(n),mcov(n,vec1D(n)),
-    n(n),kmax(kmax),lambda(lambda),nu(n*nu),
+    enum tsolver {CHOLESKY=0,UPDATE=1};
+    const double ftol=1E-8;
+    OLS(int n,int kmax=1,double lambda=0.998,double nu=0.001,double beta_sum=0.6,double beta_pow=0.75,double beta_add=2,int solver=CHOLESKY,const SIMD::tkernels *kernels=SIMD::kernels)
+    :x(n),kernels(kernels),
+    w(n),b(n),lrow(n),colpos(n+1),
+    n(n),kmax(kmax),solver(solver),lambda(lambda),nu(n*nu),
     beta_pow(beta_pow),beta_add(beta_add),esum(beta_sum)
     {
       km=0;
+      ridx=0;
       pred=0.0;
-      #ifdef INIT_COV
-        for (int i=0;i<n;i++) mcov[i][i]=1.0;
-      #endif
+      colpos[0]=0;
+      for (int j=0;j<n;j++) colpos[j+1]=colpos[j]+(((n-j)+7)&~7);
+      mchol.assign(colpos[n],0.0);
+      if (solver==UPDATE) {
+        v.assign(n,0.0);
+        for (int i=0;i<n;i++) mchol[colpos[i]]=std::sqrt(this->nu);
+        sqrt_lambda=std::sqrt(lambda);
+        ridge=std::sqrt(n*(1.0-lambda)*this->nu);
+      } else {
+        mcov.assign(colpos[n],0.0);
+        #ifdef INIT_COV
+          for (int i=0;i<n;i++) mcov[colpos[i]]=1.0;
+        #endif
+      }
     }
     double Predict()
     {
-      pred=MathUtils::dot(x.data(),w.data(),n);
+      pred=kernels->dot(x.data(),w.data(),n);
       return pred;
     }
 
@@ -32,25 +60,92 @@ class OLS {
       esum.Update(fabs(val-pred));
       double c0=pow(esum.sum+beta_add,-beta_pow);
 
-      for (int j=0;j<n;j++) {
+      if (solver==UPDATE) {
+        const double sc0=std::sqrt(c0);
+        for (int i=0;i<n;i++) v[i]=sc0*x[i];
+        UpdateFactor(0,sqrt_lambda);
+
+        std::fill(v.begin(),v.end(),0.0);
+        v[ridx]=ridge;
+        UpdateFactor(ridx,1.0);
+        if (++ridx>=n) ridx=0;
+      } else {
         // only update lower triangular
-        for (int i=0;i<=j;i++) mcov[j][i]=lambda*mcov[j][i]+c0*(x[j]*x[i]);
-        b[j]=lambda*b[j]+c0*(x[j]*val);
+        for (int i=0;i<n;i++)
+          kernels->decay_add(&mcov[colpos[i]],&x[i],x[i],lambda,c0,n-i);
       }
+      kernels->decay_add(b.data(),x.data(),val,lambda,c0,n);
 
       km++;
       if (km>=kmax) {
-        if (!chol.Factor(mcov,nu)) chol.Solve(b,w);
+        if (solver==UPDATE) Solve();
+        else if (!Factor()) Solve();
         km=0;
       }
     }
     vec1D x;
   protected:
-    MathUtils::Cholesky chol;
-    vec1D w,b;
-    vec2D mcov;
-    int n,kmax,km;
-    double lambda,nu,pred;
+    // left-looking cholesky of mcov+nu*I into mchol, no copy of mcov
+    int Factor()
+    {
+      for (int j=0;j<n;j++) {
+        double *lj=&mchol[colpos[j]];
+        const double *aj=&mcov[colpos[j]];
+
+        // diagonal, row j of the factor gathered
+        for (int k=0;k<j;k++) lrow[k]=mchol[colpos[k]+(j-k)];
+        const double sum=kernels->sub_dot(aj[0]+nu,lrow.data(),lrow.data(),j); //add regularization
+        if (sum>ftol) lj[0]=std::sqrt(sum);
+        else return 1;
+
+        // off-diagonal, rows j+1..n-1
+        const int len=n-j-1;
+        std::copy_n(aj+1,len,lj+1);
+        for (int k=0;k<j;k++) {
+          const double *lk=&mchol[colpos[k]+(j-k)];
+          kernels->sub_mul(lj+1,lk+1,lk[0],len);
+        }
+        kernels->div_by(lj+1,lj[0],len);
+      }
+      return 0;
+    }
+    // L <- chol(beta^2*L*L^T + v*v^T), v[0..k0-1] must be zero
+    // columns before k0 are left untouched, v is destroyed
+    void UpdateFactor(int k0,double beta)
+    {
+      for (int k=k0;k<n;k++) {
+        double *lk=&mchol[colpos[k]];
+        const double lkk=beta*lk[0];
+        const double r=std::sqrt(lkk*lkk+v[k]*v[k]);
+        const double c=r/lkk;
+        const double s=v[k]/lkk;
+        lk[0]=r;
+        kernels->rotate(lk+1,&v[k+1],beta,c,s,n-k-1);
+      }
+    }
+    void Solve()
+    {
+      // forward substitution, by column
+      std::copy_n(b.data(),n,w.data());
+      for (int j=0;j<n;j++) {
+        const double *lj=&mchol[colpos[j]];
+        w[j]=w[j]/lj[0];
+        kernels->sub_mul(&w[j+1],lj+1,w[j],n-j-1);
+      }
+      // backward substitution, L^T rows are our columns
+      for (int i=n-1;i>=0;i--) {
+        const double *li=&mchol[colpos[i]];
+        w[i]=kernels->sub_dot(w[i],li+1,&w[i+1],n-i-1)/li[0];
+      }
+    }
+
+
+    const SIMD::tkernels *kernels;
+    vec1D w,b,lrow;
+    std::vector<int> colpos; // start of column j in mcov/mchol
+    avec1D mcov,mchol,v;
+    int n,kmax,km,solver,ridx;
+    double lambda,nu,pred,sqrt_lambda,ridge;
     double beta_pow,beta_add;
     RunWeight esum;
 };
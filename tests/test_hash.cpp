@@ -0,0 +1,61 @@
+// known answers for the md5 and xxh64 pcm digests, in one piece and fed
+// in uneven chunks as the wav stages do
+#include "../src/common/hash.h"
+#include <algorithm>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+struct tvector {
+  std::string input;
+  const char *digest; // lowercase hex
+};
+
+static std::string Hex(const AudioHash &h)
+{
+  std::string s;
+  char buf[3];
+  for (int i=0;i<h.Size();i++) {std::snprintf(buf,sizeof(buf),"%02x",h.digest[i]);s+=buf;}
+  return s;
+}
+
+static bool Check(AudioHash::Type type,const tvector &v)
+{
+  const uint8_t *data=reinterpret_cast<const uint8_t*>(v.input.data());
+  bool ok=true;
+  for (std::size_t chunk:{v.input.size()+1,std::size_t(1),std::size_t(7),std::size_t(64),std::size_t(100)}) {
+    AudioHash h(type);
+    for (std::size_t pos=0;pos<v.input.size();pos+=chunk) h.Update(data+pos,std::min(chunk,v.input.size()-pos));
+    h.Finalize();
+    if (Hex(h)!=v.digest) {
+      std::printf("%s: %zu bytes in chunks of %zu: %s, expected %s\n",h.Name(),v.input.size(),chunk,Hex(h).c_str(),v.digest);
+      ok=false;
+    }
+  }
+  return ok;
+}
+
+int main()
+{
+  std::string pattern(1000,0); // spans several md5 blocks and xxh64 stripes
+  for (std::size_t i=0;i<pattern.size();i++) pattern[i]=static_cast<char>(i*7);
+
+  const std::vector<tvector> md5={
+    {"","d41d8cd98f00b204e9800998ecf8427e"},
+    {"abc","900150983cd24fb0d6963f7d28e17f72"},
+    {"message digest","f96b697d7cb7938d525a2f31aaf161d0"},
+    {"12345678901234567890123456789012345678901234567890123456789012345678901234567890","57edf4a22be3c955ac49da2e2107b67a"},
+    {pattern,"de809ff794e91b68f9e91a2b7030bcb0"}};
+  const std::vector<tvector> xxh64={
+    {"","ef46db3751d8e999"},
+    {"a","d24ec4f1a98c6e5b"},
+    {"abc","44bc2cf5ad770999"},
+    {"Nobody inspects the spammish repetition","fbcea83c8a378bf1"},
+    {pattern,"25275608a9cfc168"}};
+
+  int nfail=0;
+  for (const auto &v:md5) nfail+=!Check(AudioHash::HASH_MD5,v);
+  for (const auto &v:xxh64) nfail+=!Check(AudioHash::HASH_XXH64,v);
+  if (nfail) std::printf("hash: %d vectors failed\n",nfail);
+  return nfail?1:0;
+}